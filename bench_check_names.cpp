@@ -0,0 +1,625 @@
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "dict_index.h"
+#include "dictionary.h"
+#include "lev_batch.h"
+#include "levenshtein.h"
+#include "print.h"
+#include "report.h"
+#include "rules.h"
+#include "typo.h"
+
+// Synthetic inputs for the benchmarks: a dictionary of made-up words, identifiers
+// built from those words and C++ units declaring the identifiers. Everything is
+// derived from the seed, so equal options give equal inputs on every machine.
+
+enum class WordDistribution { kUniform, kZipf };
+
+struct CorpusConfig {
+    size_t units;
+    size_t decls;
+    double bad_ratio;
+    double typo_ratio;
+    WordDistribution distribution;
+    size_t dict_size;
+    unsigned seed;
+};
+
+class Corpus {
+public:
+    explicit Corpus(const CorpusConfig& config) : config_(config), rng_(config.seed) {
+        MakeDictionary();
+        if (config_.distribution == WordDistribution::kZipf) {
+            double total = 0;
+            for (size_t i = 0; i < words_.size(); ++i) {
+                total += 1.0 / static_cast<double>(i + 1);
+                weights_.push_back(total);
+            }
+        }
+    }
+
+    const std::vector<std::string>& Words() const {
+        return words_;
+    }
+
+    // A dictionary word drawn from the configured distribution, with a typo in
+    // typo_ratio of the cases.
+    std::string Word() {
+        size_t index = 0;
+        if (weights_.empty()) {
+            index = rng_() % words_.size();
+        } else {
+            double point = Uniform() * weights_.back();
+            index = std::lower_bound(weights_.begin(), weights_.end(), point) - weights_.begin();
+            index = std::min(index, words_.size() - 1);
+        }
+        auto word = words_[index];
+        if (Chance(config_.typo_ratio)) {
+            AddTypo(word);
+        }
+        return word;
+    }
+
+    bool Chance(double ratio) {
+        return Uniform() < ratio;
+    }
+
+    // A name of the entity, following its naming rule unless bad is set.
+    std::string Name(Entity entity, bool bad) {
+        size_t count = 1 + rng_() % (entity == Entity::kField ? 2 : 3);
+        std::vector<std::string> parts;
+        for (size_t i = 0; i < count; ++i) {
+            parts.push_back(Word());
+        }
+        std::string name;
+        switch (entity) {
+            case Entity::kVariable:
+                name = bad ? Join(parts, "", count > 1 ? 1 : 0) : Join(parts, "_", count);
+                break;
+            case Entity::kField:
+                name = Join(parts, "_", count) + (bad ? "" : "_");
+                break;
+            case Entity::kConst:
+                name = bad ? Upper(Join(parts, "_", count)) : "k" + Join(parts, "", 0);
+                break;
+            case Entity::kType:
+            case Entity::kFunction:
+                name = bad ? Join(parts, "_", count) : Join(parts, "", 0);
+                break;
+        }
+        return name;
+    }
+
+    // The text of a unit with decls declarations. Names are unique within the unit.
+    std::string Unit(size_t number) {
+        used_.clear();
+        std::string text = "// Synthetic unit " + std::to_string(number) + "\n\n";
+        for (size_t i = 0; i < config_.decls; ++i) {
+            switch (i % 6) {
+                case 0:
+                    text += "int " + Fresh(Entity::kVariable) + " = 0;\n\n";
+                    break;
+                case 1:
+                    text += "constexpr int " + Fresh(Entity::kConst) + " = 1;\n\n";
+                    break;
+                case 2: {
+                    auto param = Fresh(Entity::kVariable);
+                    auto local = Fresh(Entity::kVariable);
+                    text += "int " + Fresh(Entity::kFunction) + "(int " + param + ") {\n    int " +
+                            local + " = " + param + ";\n    return " + local + ";\n}\n\n";
+                    break;
+                }
+                case 3:
+                    text += "class " + Fresh(Entity::kType) + " {\n    int " +
+                            Fresh(Entity::kField) + " = 0;\n};\n\n";
+                    break;
+                case 4:
+                    text += "enum class " + Fresh(Entity::kType) + " { kFirst, kSecond };\n\n";
+                    break;
+                default:
+                    text += "using " + Fresh(Entity::kType) + " = int;\n\n";
+                    break;
+            }
+        }
+        return text;
+    }
+
+private:
+    // The standard distributions differ between libraries, the raw engine does not.
+    double Uniform() {
+        return static_cast<double>(rng_()) / (static_cast<double>(std::mt19937::max()) + 1);
+    }
+
+    void MakeDictionary() {
+        static constexpr std::string_view kConsonants = "bcdfghjklmnprstvz";
+        static constexpr std::string_view kVowels = "aeiou";
+        std::unordered_set<std::string> seen;
+        while (words_.size() < config_.dict_size) {
+            std::string word;
+            size_t syllables = 2 + rng_() % 3;
+            for (size_t i = 0; i < syllables; ++i) {
+                word += kConsonants[rng_() % kConsonants.size()];
+                word += kVowels[rng_() % kVowels.size()];
+            }
+            if (rng_() % 2 == 0) {
+                word += kConsonants[rng_() % kConsonants.size()];
+            }
+            if (!IsKeyword(word) && seen.insert(word).second) {
+                words_.push_back(word);
+            }
+        }
+    }
+
+    static bool IsKeyword(std::string_view word) {
+        return word == "case" || word == "goto" || word == "delete" || word == "volatile" ||
+               word == "register" || word == "module" || word == "import";
+    }
+
+    // One substitution, deletion or transposition, the word stays lowercase.
+    void AddTypo(std::string& word) {
+        size_t pos = rng_() % word.size();
+        switch (rng_() % 3) {
+            case 0:
+                word[pos] = static_cast<char>('a' + (word[pos] - 'a' + 1 + rng_() % 25) % 26);
+                break;
+            case 1:
+                if (word.size() > 4) {
+                    word.erase(pos, 1);
+                }
+                break;
+            default:
+                if (pos + 1 < word.size()) {
+                    std::swap(word[pos], word[pos + 1]);
+                }
+                break;
+        }
+    }
+
+    // Joins the words, capitalizing all of them from the first one to capitalize on.
+    static std::string Join(const std::vector<std::string>& parts, std::string_view separator,
+                            size_t capitalize) {
+        std::string result;
+        for (size_t i = 0; i < parts.size(); ++i) {
+            if (i > 0) {
+                result += separator;
+            }
+            auto part = parts[i];
+            if (i >= capitalize) {
+                part[0] = static_cast<char>(part[0] - 'a' + 'A');
+            }
+            result += part;
+        }
+        return result;
+    }
+
+    static std::string Upper(std::string text) {
+        for (auto& c : text) {
+            if (c >= 'a' && c <= 'z') {
+                c = static_cast<char>(c - 'a' + 'A');
+            }
+        }
+        return text;
+    }
+
+    std::string Fresh(Entity entity) {
+        bool bad = Chance(config_.bad_ratio);
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            auto name = Name(entity, bad);
+            if (used_.insert(name).second) {
+                return name;
+            }
+        }
+        throw std::runtime_error{"Too few dictionary words for unique names, raise -dict-size"};
+    }
+
+    CorpusConfig config_;
+    std::mt19937 rng_;
+    std::vector<std::string> words_;
+    std::vector<double> weights_;
+    std::unordered_set<std::string> used_;
+};
+
+// Writes unit_<i>.cpp for every unit and dict.txt with one word per line.
+bool Generate(Corpus& corpus, const CorpusConfig& config, const std::string& dir) {
+    if (auto error = llvm::sys::fs::create_directories(dir)) {
+        llvm::errs() << dir << ": " << error.message() << '\n';
+        return false;
+    }
+    std::error_code error;
+    {
+        llvm::raw_fd_ostream dict(dir + "/dict.txt", error);
+        if (error) {
+            llvm::errs() << dir << "/dict.txt: " << error.message() << '\n';
+            return false;
+        }
+        for (const auto& word : corpus.Words()) {
+            dict << word << '\n';
+        }
+    }
+    for (size_t i = 0; i < config.units; ++i) {
+        auto path = dir + "/unit_" + std::to_string(i) + ".cpp";
+        llvm::raw_fd_ostream unit(path, error);
+        if (error) {
+            llvm::errs() << path << ": " << error.message() << '\n';
+            return false;
+        }
+        unit << corpus.Unit(i);
+    }
+    return true;
+}
+
+// The distance as check_names computed it before LevPattern, kept as the baseline
+// of the lev/ benchmarks and to cross-check the kernels: every cell of the matrix
+// is computed by a call that receives a copy of the whole matrix.
+int ReferenceLevCell(const std::string& wrong_name, const std::string& good_name, size_t i,
+                     size_t j, std::vector<std::vector<int>> matrix) {
+    if (i == 0 && j == 0) {
+        return 0;
+    } else if (i == 0 && j > 0) {
+        return j;
+    } else if (j == 0 && i > 0) {
+        return i;
+    } else {
+        int m = (tolower(wrong_name[i - 1]) == good_name[j - 1]) ? 0 : 1;
+        return std::min(matrix[i][j - 1] + 1,
+                        std::min(matrix[i - 1][j] + 1, matrix[i - 1][j - 1] + m));
+    }
+}
+
+int ReferenceLevDistance(const std::string& wrong_name, const std::string& good_name) {
+    size_t n = wrong_name.size();
+    size_t m = good_name.size();
+    std::vector<std::vector<int>> matrix(n + 1, std::vector<int>(m + 1, 0));
+    for (size_t i = 0; i < n + 1; ++i) {
+        for (size_t j = 0; j < m + 1; ++j) {
+            matrix[i][j] = ReferenceLevCell(wrong_name, good_name, i, j, matrix);
+        }
+    }
+    return matrix[n][m];
+}
+
+// The heap use of the process, counted by the replaced global operator new and
+// delete below: the number of allocations and the live and peak bytes.
+std::atomic<size_t> heap_allocations = 0;
+std::atomic<size_t> heap_live = 0;
+std::atomic<size_t> heap_peak = 0;
+
+void* CountAllocation(void* pointer) {
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t live = heap_live.fetch_add(malloc_usable_size(pointer), std::memory_order_relaxed) +
+                  malloc_usable_size(pointer);
+    size_t peak = heap_peak.load(std::memory_order_relaxed);
+    while (live > peak && !heap_peak.compare_exchange_weak(peak, live)) {
+    }
+    return pointer;
+}
+
+void CountFree(void* pointer) {
+    if (pointer) {
+        heap_live.fetch_sub(malloc_usable_size(pointer), std::memory_order_relaxed);
+        std::free(pointer);
+    }
+}
+
+void* operator new(size_t size) {
+    return CountAllocation(std::malloc(size == 0 ? 1 : size));
+}
+
+// The arenas of LLVM are allocated with an alignment.
+void* operator new(size_t size, std::align_val_t align) {
+    auto alignment = static_cast<size_t>(align);
+    return CountAllocation(std::aligned_alloc(alignment, (size + alignment - 1) / alignment *
+                                                             alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+    CountFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    CountFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    CountFree(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    CountFree(pointer);
+}
+
+// A finding as check_names stored it before the string pool, owning its strings.
+struct OwnedBadNames {
+    Entity entity;
+    std::string name;
+    std::string file_name;
+    unsigned int number;
+    bool bad_mistake = true;
+    std::string good_name = "";
+    std::string wrong_name = "";
+};
+
+// The findings of the "Memory of many findings" file of run_benchmarks.sh, two bad
+// names per line, stored as records owning their strings and as handles into a
+// string pool: the heap allocations and the peak heap bytes of each. Only the
+// storage is measured, the whole run needs the clang build of that script.
+void MeasureFindingsMemory(size_t lines) {
+    // The names as the AST holds them, they are not counted.
+    std::string file = "/home/user/project/src/legacy/bench-many.cpp";
+    std::vector<std::string> identifiers;
+    for (size_t i = 1; i <= lines; ++i) {
+        identifiers.push_back("bad_Name" + std::to_string(i));
+        identifiers.push_back("Wrong_Value" + std::to_string(i));
+    }
+    auto measure = [&](const char* name, auto store) {
+        size_t allocations = heap_allocations.load();
+        size_t live = heap_live.load();
+        heap_peak = live;
+        size_t findings = store();
+        llvm::outs() << "bench=findings/" << name << " findings=" << findings
+                     << " allocations=" << heap_allocations.load() - allocations
+                     << " peak_heap_kb=" << (heap_peak.load() - live) / 1024 << '\n';
+    };
+    measure("owned", [&] {
+        std::vector<OwnedBadNames> names;
+        for (size_t i = 0; i < identifiers.size(); ++i) {
+            auto line = static_cast<unsigned int>(i / 2 + 1);
+            names.push_back({Entity::kVariable, identifiers[i], file, line});
+        }
+        return names.size();
+    });
+    measure("interned", [&] {
+        StringPool pool;
+        std::vector<BadNames> names;
+        for (size_t i = 0; i < identifiers.size(); ++i) {
+            auto line = static_cast<unsigned int>(i / 2 + 1);
+            names.push_back({Entity::kVariable, pool.Intern(identifiers[i]), pool.Intern(file),
+                             line});
+        }
+        return names.size();
+    });
+}
+
+// Keeps the measured work from being optimized away.
+volatile size_t bench_sink = 0;
+
+// Runs body repetitions times and prints the best time per operation, which is
+// the least noisy statistic for short deterministic loops. With a unit, the same
+// time is also printed as a throughput, <unit>_per_s.
+template <class Body>
+void Measure(const std::string& name, unsigned repetitions, size_t ops, Body&& body,
+             const char* unit = nullptr) {
+    double best = 0;
+    for (unsigned i = 0; i < repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        bench_sink = bench_sink + body();
+        std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+        double per_op = spent.count() / static_cast<double>(ops);
+        if (i == 0 || per_op < best) {
+            best = per_op;
+        }
+    }
+    llvm::outs() << "bench=" << name << " ns_per_op=" << llvm::format("%.1f", best);
+    if (unit) {
+        llvm::outs() << ' ' << unit << "_per_s=" << llvm::format("%.0f", 1e9 / best);
+    }
+    llvm::outs() << '\n';
+}
+
+// Returns false if a kernel disagrees with the reference distance.
+bool RunMicrobenchmarks(Corpus& corpus, unsigned repetitions) {
+    constexpr size_t kNames = 10000;
+    constexpr size_t kPairs = 5000;
+    constexpr size_t kTypoNames = 1000;
+    constexpr size_t kBatchQueries = 200;
+
+    for (auto entity : {Entity::kVariable, Entity::kField, Entity::kType, Entity::kConst,
+                        Entity::kFunction}) {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < kNames; ++i) {
+            names.push_back(corpus.Name(entity, corpus.Chance(0.5)));
+        }
+        Measure("rules/" + Str(entity), repetitions, names.size(), [&] {
+            size_t matches = 0;
+            for (const auto& name : names) {
+                matches += MatchesNamingRule(entity, name);
+            }
+            return matches;
+        });
+    }
+
+    const auto& words = corpus.Words();
+    std::vector<std::pair<std::string, std::string>> pairs;
+    for (size_t i = 0; i < kPairs; ++i) {
+        pairs.emplace_back(corpus.Word(), words[(i * 7919) % words.size()]);
+    }
+    std::vector<LevPattern> patterns;
+    for (const auto& pair : pairs) {
+        patterns.emplace_back(pair.first);
+    }
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        const auto& [wrong, good] = pairs[i];
+        int expected = ReferenceLevDistance(wrong, good);
+        int bounded = std::min(expected, kMaxTypoDistance + 1);
+        if (CalcLevDistance(wrong, good) != expected ||
+            patterns[i].Distance(good, kMaxTypoDistance) != bounded) {
+            llvm::errs() << "Distance of " << wrong << " and " << good
+                         << " differs from the reference " << expected << '\n';
+            return false;
+        }
+    }
+    Measure("lev/reference", repetitions, pairs.size(), [&] {
+        size_t total = 0;
+        for (const auto& [wrong, good] : pairs) {
+            total += ReferenceLevDistance(wrong, good);
+        }
+        return total;
+    });
+    Measure("lev/CalcLevDistance", repetitions, pairs.size(), [&] {
+        size_t total = 0;
+        for (const auto& [wrong, good] : pairs) {
+            total += CalcLevDistance(wrong, good);
+        }
+        return total;
+    });
+    Measure("lev/bounded", repetitions, pairs.size(), [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            total += patterns[i].Distance(pairs[i].second, kMaxTypoDistance);
+        }
+        return total;
+    });
+
+    // The batch kernels of DictIndex on whole length buckets, as if no signature
+    // filtered them: every dictionary word within kMaxTypoDistance of the length of
+    // a query is scored, throughput in dictionary words per second.
+    std::vector<std::vector<std::string_view>> buckets;
+    for (const auto& word : words) {
+        buckets.resize(std::max(buckets.size(), word.size() + 1));
+        buckets[word.size()].push_back(word);
+    }
+    auto near_buckets = [&](const LevPattern& pattern) {
+        size_t len = pattern.Word().size();
+        size_t first = len > kMaxTypoDistance ? len - kMaxTypoDistance : 0;
+        size_t last = std::min(len + kMaxTypoDistance + 1, buckets.size());
+        return std::make_pair(first, std::max(first, last));
+    };
+    size_t batch_words = 0;
+    for (size_t i = 0; i < kBatchQueries && i < patterns.size(); ++i) {
+        auto [first, last] = near_buckets(patterns[i]);
+        for (size_t len = first; len < last; ++len) {
+            batch_words += buckets[len].size();
+        }
+    }
+    for (auto kernel : {LevKernel::kScalar, LevKernel::kSse, LevKernel::kAvx,
+                        LevKernel::kAvxWide}) {
+        if (!Supported(kernel)) {
+            continue;
+        }
+        Measure("lev-batch/" + Str(kernel), repetitions, batch_words, [&] {
+            size_t total = 0;
+            std::array<int, kMaxBatchWords> distances;
+            for (size_t i = 0; i < kBatchQueries && i < patterns.size(); ++i) {
+                LevBatch batch(patterns[i], kernel);
+                auto [first, last] = near_buckets(patterns[i]);
+                for (size_t len = first; len < last; ++len) {
+                    const auto& bucket = buckets[len];
+                    for (size_t start = 0; start < bucket.size(); start += batch.Capacity()) {
+                        size_t count = std::min(batch.Capacity(), bucket.size() - start);
+                        batch.Score(bucket.data() + start, count, kMaxTypoDistance,
+                                    distances.data());
+                        for (size_t k = 0; k < count; ++k) {
+                            total += distances[k];
+                        }
+                    }
+                }
+            }
+            return total;
+        }, "words");
+    }
+
+    std::string text;
+    for (const auto& word : words) {
+        text.append(word).append("\n");
+    }
+    Dictionary dict;
+    if (auto error = dict.Read(text)) {
+        llvm::errs() << llvm::toString(std::move(error)) << '\n';
+        return false;
+    }
+    // The typo check of CalcMistake and MyPrint::ResolveMistakes without the AST:
+    // split the names, resolve the distinct words in one batch, look every word up.
+    std::vector<std::string> typo_names;
+    for (size_t i = 0; i < kTypoNames; ++i) {
+        typo_names.push_back(corpus.Name(Entity::kVariable, false));
+    }
+    for (auto kind : {DictIndexKind::kLinear, DictIndexKind::kLength, DictIndexKind::kDeletes}) {
+        if (kind != DictIndexKind::kLinear) {
+            Measure("index-build/" + Str(kind), repetitions, dict.Size(), [&] {
+                DictIndex index(dict, kind);
+                return index.MemoryUsage();
+            });
+        }
+        DictIndex index(dict, kind);
+        Measure("typo/" + Str(kind), repetitions, typo_names.size(), [&] {
+            TypoStage stage(index, 1);
+            std::vector<std::string_view> batch;
+            for (const auto& name : typo_names) {
+                for (auto word : SplitWords(name)) {
+                    if (word.size() > 3) {
+                        batch.push_back(word);
+                    }
+                }
+            }
+            stage.Resolve(batch);
+            size_t found = 0;
+            for (auto word : batch) {
+                found += stage.Lookup(word).distance <= kMaxTypoDistance;
+            }
+            return found;
+        });
+    }
+    return true;
+}
+
+int main(int argc, const char** argv) {
+    llvm::cl::opt<std::string> generate{
+        "generate", llvm::cl::desc("Write a synthetic corpus into this directory and exit")};
+    llvm::cl::opt<size_t> units{"units", llvm::cl::desc("Number of translation units"),
+                                llvm::cl::init(50)};
+    llvm::cl::opt<size_t> decls{"decls", llvm::cl::desc("Declarations per translation unit"),
+                                llvm::cl::init(200)};
+    llvm::cl::opt<double> bad_ratio{"bad-ratio",
+                                    llvm::cl::desc("Share of names breaking the naming rules"),
+                                    llvm::cl::init(0.1)};
+    llvm::cl::opt<double> typo_ratio{"typo-ratio",
+                                     llvm::cl::desc("Share of identifier words with a typo"),
+                                     llvm::cl::init(0.05)};
+    llvm::cl::opt<WordDistribution> distribution{
+        "words", llvm::cl::desc("Distribution of the dictionary words in identifiers"),
+        llvm::cl::init(WordDistribution::kZipf),
+        llvm::cl::values(clEnumValN(WordDistribution::kUniform, "uniform", "every word equally"),
+                         clEnumValN(WordDistribution::kZipf, "zipf", "word i with weight 1/i"))};
+    llvm::cl::opt<size_t> dict_size{"dict-size", llvm::cl::desc("Number of dictionary words"),
+                                    llvm::cl::init(20000)};
+    llvm::cl::opt<unsigned> seed{"seed", llvm::cl::desc("Seed of the generator"),
+                                 llvm::cl::init(1)};
+    llvm::cl::opt<unsigned> repetitions{
+        "repetitions", llvm::cl::desc("Runs of each microbenchmark, the best one is reported"),
+        llvm::cl::init(5)};
+    llvm::cl::ParseCommandLineOptions(argc, argv, "check_names benchmarks\n");
+
+    if (dict_size == 0) {
+        llvm::errs() << "-dict-size must be positive\n";
+        return 1;
+    }
+    CorpusConfig config{units, decls, bad_ratio, typo_ratio, distribution, dict_size, seed};
+    Corpus corpus(config);
+    if (!generate.empty()) {
+        return Generate(corpus, config, generate) ? 0 : 1;
+    }
+    MeasureFindingsMemory(20000);
+    return RunMicrobenchmarks(corpus, repetitions) ? 0 : 1;
+}
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+
+// Lines first..last of a file, both included.
+using LineRange = std::pair<unsigned, unsigned>;
+
+inline std::string RealPath(llvm::StringRef path) {
+    llvm::SmallString<256> real;
+    if (llvm::sys::fs::real_path(path, real)) {
+        return path.str();
+    }
+    return real.str().str();
+}
+
+// The -I and -iquote directories of the unit, absolute.
+inline std::vector<std::string> IncludeDirs(const clang::tooling::CompileCommand& command) {
+    std::vector<std::string> dirs;
+    const auto& args = command.CommandLine;
+    for (size_t i = 0; i < args.size(); ++i) {
+        llvm::StringRef arg = args[i];
+        llvm::StringRef dir;
+        for (llvm::StringRef flag : {"-I", "-iquote"}) {
+            if (arg == flag && i + 1 < args.size()) {
+                dir = args[++i];
+            } else if (arg.startswith(flag) && arg.size() > flag.size()) {
+                dir = arg.drop_front(flag.size());
+            }
+        }
+        if (dir.empty()) {
+            continue;
+        }
+        llvm::SmallString<256> path(dir);
+        llvm::sys::fs::make_absolute(command.Directory, path);
+        dirs.push_back(path.str().str());
+    }
+    return dirs;
+}
+
+// The lines a unified diff adds or changes, by the real path of the file. Removed
+// lines leave nothing to check and are not recorded.
+class ChangedLines {
+public:
+    // The output of git diff or diff -u, its paths are relative to root. The a/ and b/
+    // prefixes of git are dropped, as patch -p1 does, if the path does not exist with
+    // them.
+    llvm::Error Parse(llvm::StringRef diff, const std::string& root) {
+        std::vector<LineRange>* ranges = nullptr;
+        unsigned line = 0;
+        unsigned old_left = 0;
+        unsigned new_left = 0;
+        while (!diff.empty()) {
+            llvm::StringRef text;
+            std::tie(text, diff) = diff.split('\n');
+            text = text.rtrim('\r');
+            if (old_left > 0 || new_left > 0) {
+                // The body of a hunk.
+                if (text.startswith("+") && new_left > 0) {
+                    if (ranges && !ranges->empty() && ranges->back().second + 1 == line) {
+                        ranges->back().second = line;
+                    } else if (ranges) {
+                        ranges->emplace_back(line, line);
+                    }
+                    ++line;
+                    --new_left;
+                } else if (text.startswith("-") && old_left > 0) {
+                    --old_left;
+                } else if (!text.startswith("\\")) {
+                    ++line;
+                    old_left -= old_left > 0;
+                    new_left -= new_left > 0;
+                }
+            } else if (text.consume_front("+++ ")) {
+                auto path = text.split('\t').first.rtrim();
+                ranges = path == "/dev/null" ? nullptr : &files_[Resolve(path, root)];
+            } else if (text.consume_front("@@ -")) {
+                // @@ -old_start[,old_count] +new_start[,new_count] @@
+                llvm::StringRef old_range;
+                llvm::StringRef new_range;
+                std::tie(old_range, text) = text.split(" +");
+                new_range = text.split(' ').first;
+                if (!ParseRange(old_range, nullptr, old_left) ||
+                    !ParseRange(new_range, &line, new_left)) {
+                    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                                   "Bad hunk header: @@ -%s",
+                                                   old_range.str().c_str());
+                }
+            }
+        }
+        // Files with removed lines only.
+        for (auto it = files_.begin(); it != files_.end();) {
+            it = it->second.empty() ? files_.erase(it) : std::next(it);
+        }
+        return llvm::Error::success();
+    }
+
+    // Runs git diff for a revision (against the work tree) or a revision range in the
+    // current directory, the paths are relative to the top of the work tree. The line
+    // numbers of a range A..B are those of B, while the checked files are those of the
+    // work tree, so a range is accepted only if B is HEAD and the tracked files have no
+    // changes.
+    llvm::Error ParseGitDiff(const std::string& revisions) {
+        auto git = llvm::sys::findProgramByName("git");
+        if (!git) {
+            return llvm::createStringError(git.getError(), "git not found");
+        }
+        auto root = RunGit(*git, {"rev-parse", "--show-toplevel"});
+        if (!root) {
+            return root.takeError();
+        }
+        if (auto dots = revisions.find(".."); dots != std::string::npos) {
+            auto target = llvm::StringRef(revisions).substr(dots).ltrim('.');
+            if (auto error = CheckWorkTreeIs(*git, target.empty() ? "HEAD" : target)) {
+                return error;
+            }
+        }
+        auto diff = RunGit(*git, {"diff", "-U0", "--no-color", "--no-ext-diff", "--no-renames",
+                                  revisions});
+        if (!diff) {
+            return diff.takeError();
+        }
+        return Parse(*diff, llvm::StringRef(*root).rtrim().str());
+    }
+
+    bool Empty() const {
+        return files_.empty();
+    }
+
+    // The changed lines of a file by its real path, nullptr if it has none.
+    const std::vector<LineRange>* Find(llvm::StringRef real_path) const {
+        auto it = files_.find(real_path.str());
+        return it == files_.end() ? nullptr : &it->second;
+    }
+
+    static bool Contains(const std::vector<LineRange>& ranges, unsigned line) {
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), LineRange{line, ~0u});
+        return it != ranges.begin() && std::prev(it)->second >= line;
+    }
+
+    // The units that can have a changed line: those changed themselves and those
+    // that include a changed file, directly or through other headers. The includes
+    // are found in the text, in the directory of the including file and the -I and
+    // -iquote ones of the unit, whatever the conditional directives around them, so a
+    // unit is kept rather than dropped when in doubt. Only a change outside of the
+    // units themselves needs that scan.
+    std::vector<std::string> Units(const clang::tooling::CompilationDatabase& compilations,
+                                   const std::vector<std::string>& files) {
+        std::set<std::string> units;
+        for (const auto& file : files) {
+            units.insert(RealPath(file));
+        }
+        bool headers_changed = false;
+        for (const auto& [path, ranges] : files_) {
+            headers_changed |= units.count(path) == 0;
+        }
+        std::vector<std::string> result;
+        for (const auto& file : files) {
+            if (files_.count(RealPath(file)) != 0 ||
+                (headers_changed && IncludesChanged(compilations, file))) {
+                result.push_back(file);
+            }
+        }
+        return result;
+    }
+
+private:
+    // "start[,count]", the count is 1 if omitted.
+    static bool ParseRange(llvm::StringRef range, unsigned* start, unsigned& count) {
+        auto [first, length] = range.split(',');
+        unsigned value = 0;
+        count = 1;
+        if (first.getAsInteger(10, value) || (!length.empty() && length.getAsInteger(10, count))) {
+            return false;
+        }
+        if (start) {
+            *start = value;
+        }
+        return true;
+    }
+
+    static std::string Resolve(llvm::StringRef path, const std::string& root) {
+        if (llvm::sys::path::is_absolute(path)) {
+            return RealPath(path);
+        }
+        llvm::SmallString<256> full(root);
+        llvm::sys::path::append(full, path);
+        if (!llvm::sys::fs::exists(full) && path.contains('/')) {
+            full = root;
+            llvm::sys::path::append(full, path.split('/').second);
+        }
+        return RealPath(full);
+    }
+
+    // Fails unless the revision is HEAD and the tracked files have no changes.
+    static llvm::Error CheckWorkTreeIs(llvm::StringRef git, llvm::StringRef revision) {
+        auto target = RunGit(git, {"rev-parse", "--verify", "--end-of-options",
+                                   revision.str() + "^{commit}"});
+        if (!target) {
+            return target.takeError();
+        }
+        auto head = RunGit(git, {"rev-parse", "--verify", "HEAD"});
+        if (!head) {
+            return head.takeError();
+        }
+        if (llvm::StringRef(*target).rtrim() != llvm::StringRef(*head).rtrim()) {
+            return llvm::createStringError(
+                llvm::inconvertibleErrorCode(),
+                "The range ends at %s, which is not checked out, its lines would not match the "
+                "work tree; check it out or give a single revision",
+                revision.str().c_str());
+        }
+        auto status = RunGit(git, {"status", "--porcelain", "--untracked-files=no"});
+        if (!status) {
+            return status.takeError();
+        }
+        if (!llvm::StringRef(*status).trim().empty()) {
+            return llvm::createStringError(
+                llvm::inconvertibleErrorCode(),
+                "The work tree has uncommitted changes, the lines of the range would not match "
+                "it; commit them or give a single revision");
+        }
+        return llvm::Error::success();
+    }
+
+    static llvm::Expected<std::string> RunGit(llvm::StringRef git,
+                                              std::vector<llvm::StringRef> args) {
+        llvm::SmallString<128> output;
+        if (auto error = llvm::sys::fs::createTemporaryFile("check_names-git", "txt", output)) {
+            return llvm::createStringError(error, "Cannot create a temporary file");
+        }
+        args.insert(args.begin(), git);
+        llvm::Optional<llvm::StringRef> redirects[] = {llvm::None, llvm::StringRef(output),
+                                                       llvm::None};
+        std::string message;
+        int status = llvm::sys::ExecuteAndWait(git, args, llvm::None, redirects, 0, 0, &message);
+        auto buffer = llvm::MemoryBuffer::getFile(output);
+        llvm::sys::fs::remove(output);
+        if (status != 0 || !buffer) {
+            return llvm::createStringError(llvm::inconvertibleErrorCode(), "git %s failed%s%s",
+                                           args[1].str().c_str(), message.empty() ? "" : ": ",
+                                           message.c_str());
+        }
+        return (*buffer)->getBuffer().str();
+    }
+
+    // The names of the #include lines of a file, read once.
+    const std::vector<std::pair<bool, std::string>>& Includes(const std::string& path) {
+        auto [it, inserted] = includes_.try_emplace(path);
+        if (!inserted) {
+            return it->second;
+        }
+        auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+        if (!buffer) {
+            return it->second;
+        }
+        llvm::StringRef text = (*buffer)->getBuffer();
+        while (!text.empty()) {
+            llvm::StringRef line;
+            std::tie(line, text) = text.split('\n');
+            line = line.ltrim();
+            if (!line.consume_front("#")) {
+                continue;
+            }
+            line = line.ltrim();
+            if (!line.consume_front("include")) {
+                continue;
+            }
+            line = line.ltrim();
+            bool quoted = line.startswith("\"");
+            if (!quoted && !line.startswith("<")) {
+                continue;
+            }
+            line = line.drop_front();
+            size_t end = line.find(quoted ? '"' : '>');
+            if (end != llvm::StringRef::npos) {
+                it->second.emplace_back(quoted, line.take_front(end).str());
+            }
+        }
+        return it->second;
+    }
+
+    bool IncludesChanged(const clang::tooling::CompilationDatabase& compilations,
+                         const std::string& file) {
+        auto commands = compilations.getCompileCommands(file);
+        if (commands.empty()) {
+            return true;
+        }
+        auto dirs = IncludeDirs(commands.front());
+        llvm::SmallString<256> main(file);
+        llvm::sys::fs::make_absolute(commands.front().Directory, main);
+        std::vector<std::string> pending{RealPath(main)};
+        std::set<std::string> visited(pending.begin(), pending.end());
+        while (!pending.empty()) {
+            auto current = std::move(pending.back());
+            pending.pop_back();
+            if (files_.count(current) != 0) {
+                return true;
+            }
+            auto parent = llvm::sys::path::parent_path(current).str();
+            for (const auto& [quoted, name] : Includes(current)) {
+                std::vector<const std::string*> candidates;
+                if (quoted) {
+                    candidates.push_back(&parent);
+                }
+                for (const auto& dir : dirs) {
+                    candidates.push_back(&dir);
+                }
+                for (const auto* dir : candidates) {
+                    llvm::SmallString<256> path(*dir);
+                    llvm::sys::path::append(path, name);
+                    if (llvm::sys::fs::is_regular_file(path)) {
+                        auto real = RealPath(path);
+                        if (visited.insert(real).second) {
+                            pending.push_back(std::move(real));
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    std::map<std::string, std::vector<LineRange>> files_;                         // NOLINT
+    std::map<std::string, std::vector<std::pair<bool, std::string>>> includes_;  // NOLINT
+};
@@ -3,505 +3,2355 @@
 #include <clang/Tooling/Tooling.h>
 
 #include <clang/Frontend/FrontendActions.h>
+#include <clang/Frontend/MultiplexConsumer.h>
 #include <clang/AST/RecursiveASTVisitor.h>
 
 #include <clang/ASTMatchers/ASTMatchFinder.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
 
-#include <regex>
+#include <clang/Lex/Lexer.h>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/VirtualFileSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <set>
 #include <string>
+#include <tuple>
 #include <vector>
-#include <fstream>
+#include "changed_lines.h"
+#include "dict_index.h"
+#include "dictionary.h"
+#include "levenshtein.h"
+#include "lexer_scan.h"
+#include "path_filter.h"
 #include "print.h"
+#include "report.h"
+#include "result_cache.h"
+#include "run_stats.h"
+#include "shared_preamble.h"
+#include "rules.h"
+#include "typo.h"
+#include "unit_costs.h"
+#include "unix_socket.h"
 
-struct BadNames {
-    Entity entity;
-    std::string name;
-    std::string file_name;
-    unsigned int number;
-    bool bad_mistake = true;
-    std::string good_name = "";
-    std::string wrong_name = "";
-};
+StringPool string_pool;
+RunStats run_stats;
 
 class MyPrint {
 public:
     void SetFileName(const std::string& filename) {
-        // bad_names_.clear();
-        if (filename_.empty()) {
-            filename_ = filename;
-            return;
-        }
-        if (filename != filename_) {
-            Print();
-            filename_ = filename;
+        if (!files_.empty() && files_.back().file_name.empty()) {
+            files_.back().file_name = filename;
+        } else if (files_.empty() || files_.back().file_name != filename) {
+            files_.push_back({filename, {}});
         }
     }
 
+    // The strings of names may be temporary, they are interned here.
     void SetBadNames(const BadNames& names) {
-        bad_names_.push_back(names);
-        if (names.bad_mistake) {
-            ++bad_num_;
+        if (files_.empty()) {
+            files_.emplace_back();
+        }
+        files_.back().bad_names.push_back(Interned(names));
+    }
+
+    // The number of findings in the current file block.
+    size_t Mark() const {
+        return files_.empty() ? 0 : files_.back().bad_names.size();
+    }
+
+    // The findings added to the current file block after mark. They are removed from
+    // the block if take is set.
+    std::vector<BadNames> Since(size_t mark, bool take) {
+        if (files_.empty()) {
+            return {};
+        }
+        auto& names = files_.back().bad_names;
+        std::vector<BadNames> result(names.begin() + mark, names.end());
+        if (take) {
+            names.resize(mark);
+        }
+        return result;
+    }
+
+    // The findings before the typo stage, as stored in the result cache.
+    llvm::json::Value ToJson() const {
+        llvm::json::Array files;
+        for (const auto& file : files_) {
+            llvm::json::Array names;
+            for (const auto& item : file.bad_names) {
+                names.push_back(llvm::json::Object{{"entity", static_cast<int>(item.entity)},
+                                                   {"name", item.name},
+                                                   {"file", item.file_name},
+                                                   {"line", item.number},
+                                                   {"bad", item.bad_mistake},
+                                                   {"word", item.wrong_name}});
+            }
+            files.push_back(
+                llvm::json::Object{{"file", file.file_name}, {"names", std::move(names)}});
+        }
+        return files;
+    }
+
+    // Appends the findings written by ToJson, returns false if the value is malformed.
+    bool ReadJson(const llvm::json::Value& value) {
+        auto* files = value.getAsArray();
+        if (!files) {
+            return false;
+        }
+        for (const auto& file : *files) {
+            auto* object = file.getAsObject();
+            auto* names = object ? object->getArray("names") : nullptr;
+            if (!names || !object->getString("file")) {
+                return false;
+            }
+            FileReport report{object->getString("file")->str(), {}};
+            for (const auto& name : *names) {
+                auto* item = name.getAsObject();
+                if (!item) {
+                    return false;
+                }
+                auto entity = item->getInteger("entity");
+                auto text = item->getString("name");
+                auto file_name = item->getString("file");
+                auto line = item->getInteger("line");
+                auto bad = item->getBoolean("bad");
+                auto word = item->getString("word");
+                if (!entity || *entity < 0 || *entity > static_cast<int>(Entity::kFunction) ||
+                    !text || !file_name || !line || !bad || !word) {
+                    return false;
+                }
+                report.bad_names.push_back(Interned({static_cast<Entity>(*entity), *text,
+                                                     *file_name, static_cast<unsigned int>(*line),
+                                                     *bad, "", *word}));
+            }
+            files_.push_back(std::move(report));
+        }
+        return true;
+    }
+
+    // Typo findings are recorded with the identifier word only. The words of the first
+    // count file blocks are looked up together, the dictionary word is filled in and
+    // the findings without a close enough word are dropped.
+    void ResolveMistakes(TypoStage& stage, const Dictionary& dict, size_t count) {
+        std::vector<std::string_view> words;
+        for (size_t i = 0; i < count; ++i) {
+            for (const auto& item : files_[i].bad_names) {
+                if (!item.bad_mistake) {
+                    words.push_back(item.wrong_name);
+                }
+            }
+        }
+        stage.Resolve(words);
+        for (size_t i = 0; i < count; ++i) {
+            auto& file = files_[i];
+            std::vector<BadNames> resolved;
+            resolved.reserve(file.bad_names.size());
+            for (auto& item : file.bad_names) {
+                if (!item.bad_mistake) {
+                    const auto& nearest = stage.Lookup(item.wrong_name);
+                    if (nearest.distance > kMaxTypoDistance || nearest.distance == 0) {
+                        continue;
+                    }
+                    item.good_name = dict[nearest.index];
+                }
+                resolved.push_back(std::move(item));
+            }
+            file.bad_names = std::move(resolved);
         }
     }
 
-    void Print() {
-        std::string true_file_name = filename_.substr(filename_.find_last_of('/') + 1);
-        PrintStatistics(true_file_name, bad_num_, bad_names_.size() - bad_num_);
-        for (auto item : bad_names_) {
-            true_file_name = item.file_name.substr(item.file_name.find_last_of('/') + 1);
-            if (item.bad_mistake) {
-                BadName(item.entity, item.name, true_file_name, item.number);
+    // Takes the report of the next translation unit, as if it had been printed into
+    // this one.
+    void Append(MyPrint&& other) {
+        for (auto& file : other.files_) {
+            if (!files_.empty() && files_.back().file_name == file.file_name) {
+                auto& names = files_.back().bad_names;
+                std::move(file.bad_names.begin(), file.bad_names.end(), std::back_inserter(names));
             } else {
-                Mistake(item.name, item.wrong_name, item.good_name, true_file_name, item.number);
+                files_.push_back(std::move(file));
+            }
+        }
+        other.files_.clear();
+    }
+
+    // Hands the complete file blocks to the reporter and drops them, returns their
+    // number. The last block is kept if the next report may still continue it.
+    size_t Flush(Reporter& reporter, TypoStage& stage, const Dictionary& dict,
+                 bool keep_last) {
+        size_t count = files_.size() - (keep_last && !files_.empty() ? 1 : 0);
+        ResolveMistakes(stage, dict, count);
+        for (size_t i = 0; i < count; ++i) {
+            const auto& file = files_[i];
+            int bad_num = std::count_if(file.bad_names.begin(), file.bad_names.end(),
+                                        [](const BadNames& item) { return item.bad_mistake; });
+            reporter.BeginFile(file.file_name, bad_num, file.bad_names.size() - bad_num);
+            for (const auto& item : file.bad_names) {
+                reporter.Report(item);
+                if (run_stats.Enabled()) {
+                    run_stats.AddFinding(item.entity, item.bad_mistake);
+                }
             }
         }
-        bad_num_ = 0;
-        bad_names_.clear();
-        filename_.clear();
+        files_.erase(files_.begin(), files_.begin() + count);
+        return count;
     }
 
 private:
-    std::string filename_;             // NOLINT
-    std::vector<BadNames> bad_names_;  // NOLINT
-    int bad_num_ = 0;                  // NOLINT
+    static BadNames Interned(BadNames item) {
+        item.name = string_pool.Intern(item.name);
+        item.file_name = string_pool.Intern(item.file_name);
+        item.wrong_name = string_pool.Intern(item.wrong_name);
+        return item;
+    }
+
+    std::vector<FileReport> files_;  // NOLINT
 };
 
-MyPrint printer;
-std::vector<std::string> my_dict;
+// The reports of the units in their final order. Every block that can no longer
+// change is resolved and reported right away, so only the last one is kept.
+class ReportStream {
+public:
+    ReportStream(Reporter& reporter, TypoStage& stage, const Dictionary& dict)
+        : reporter_(reporter), stage_(stage), dict_(dict) {
+    }
 
-int LevDistance(const std::string& wrong_name, const std::string& good_name, size_t i, size_t j,
-                std::vector<std::vector<int>> matrix) {
-    if (i == 0 && j == 0) {
-        return 0;
-    } else if (i == 0 && j > 0) {
-        return j;
-    } else if (j == 0 && i > 0) {
-        return i;
-    } else {
-        int m = (tolower(wrong_name[i - 1]) == good_name[j - 1]) ? 0 : 1;
-        return std::min(matrix[i][j - 1] + 1,
-                        std::min(matrix[i - 1][j] + 1, matrix[i - 1][j - 1] + m));
+    void Add(MyPrint&& report) {
+        pending_.Append(std::move(report));
+        emitted_ += pending_.Flush(reporter_, stage_, dict_, true);
     }
-}
 
-int CalcLevDistance(const std::string& wrong_name, const std::string& good_name) {
-    size_t n = wrong_name.size();
-    size_t m = good_name.size();
-    std::vector<std::vector<int>> matrix(n + 1, std::vector<int>(m + 1, 0));
-    for (size_t i = 0; i < n + 1; ++i) {
-        for (size_t j = 0; j < m + 1; ++j) {
-            matrix[i][j] = LevDistance(wrong_name, good_name, i, j, matrix);
+    void Finish() {
+        emitted_ += pending_.Flush(reporter_, stage_, dict_, false);
+        // A run without a single match still prints one (unnamed) block.
+        if (emitted_ == 0) {
+            reporter_.BeginFile("", 0, 0);
         }
+        reporter_.Finish();
     }
-    return matrix[n][m];
-}
 
-void CalcMistake(const std::string& string, const std::string& filename,
-                 const unsigned int& number) {
-    std::vector<std::string> substr;
-    std::string token;
-    for (size_t i = 0; i < string.size(); ++i) {
-        if (string[i] == '_') {
-            substr.push_back(token);
-            token.clear();
-            continue;
+private:
+    Reporter& reporter_;      // NOLINT
+    TypoStage& stage_;        // NOLINT
+    const Dictionary& dict_;  // NOLINT
+    MyPrint pending_;         // NOLINT
+    size_t emitted_ = 0;      // NOLINT
+};
+
+// How the findings in headers shared by several translation units are reported.
+enum class HeaderReport { kEach, kOnce };
+
+// Declarations outside of the main file that some translation unit of the run has
+// already checked, keyed by the file, the offset of the declaration in it and its
+// name (a macro expansion can declare several names at one offset). The findings
+// are kept, so the other units replay them instead of checking again. In the kOnce
+// mode they are reported only in a section of their own, one block per header.
+class SeenDecls {
+public:
+    using Key = std::tuple<llvm::sys::fs::UniqueID, unsigned, std::string>;
+
+    explicit SeenDecls(HeaderReport mode) : mode_(mode) {
+    }
+
+    HeaderReport Mode() const {
+        return mode_;
+    }
+
+    // Returns false if the declaration has not been checked yet.
+    bool Replay(const Key& key, MyPrint& printer) {
+        std::lock_guard lock(mutex_);
+        auto it = findings_.find(key);
+        if (it == findings_.end()) {
+            return false;
         }
-        if (string[i] >= 'A' && string[i] <= 'Z') {
-            if (!token.empty()) {
-                substr.push_back(token);
-                token.clear();
-                token.push_back(string[i]);
-                continue;
+        if (mode_ == HeaderReport::kEach) {
+            for (const auto& item : it->second) {
+                printer.SetBadNames(item);
             }
         }
-        token.push_back(string[i]);
+        return true;
     }
-    substr.push_back(token);
-    for (auto item : substr) {
-        if (item.size() <= 3) {
-            continue;
+
+    // Several units may check a declaration at once, only the first result is kept.
+    void Record(const Key& key, const std::string& header, std::vector<BadNames> findings) {
+        std::lock_guard lock(mutex_);
+        auto [it, inserted] = findings_.emplace(key, std::move(findings));
+        if (inserted && mode_ == HeaderReport::kOnce && !it->second.empty()) {
+            headers_[header][{std::get<1>(key), std::get<2>(key)}] = it->second;
+        }
+    }
+
+    // Adds the header section to the report, sorted by the header and the offset so
+    // that it does not depend on the order the units were checked in.
+    void AppendHeaders(MyPrint& report) {
+        MyPrint section;
+        for (const auto& [header, decls] : headers_) {
+            section.SetFileName(header);
+            for (const auto& [decl, findings] : decls) {
+                for (const auto& item : findings) {
+                    section.SetBadNames(item);
+                }
+            }
         }
-        int min = 4;
-        int min_ind = 0;
-        for (size_t i = 0; i < my_dict.size(); ++i) {
-            if (CalcLevDistance(item, my_dict[i]) < min) {
-                min = CalcLevDistance(item, my_dict[i]);
-                min_ind = i;
+        report.Append(std::move(section));
+        headers_.clear();
+    }
+
+    // The header section recorded so far, for a shard file.
+    llvm::json::Value HeadersToJson() const {
+        llvm::json::Array headers;
+        for (const auto& [header, decls] : headers_) {
+            for (const auto& [decl, findings] : decls) {
+                MyPrint block;
+                block.SetFileName(header);
+                for (const auto& item : findings) {
+                    block.SetBadNames(item);
+                }
+                headers.push_back(llvm::json::Object{{"header", header},
+                                                     {"offset", decl.first},
+                                                     {"name", decl.second},
+                                                     {"findings", block.ToJson()}});
+            }
+        }
+        return headers;
+    }
+
+    // Adds the header section of a shard file. A declaration several shards have
+    // checked keeps the findings read first, they are the same. Returns false if the
+    // value is malformed.
+    bool ReadHeaders(const llvm::json::Value& value) {
+        auto* headers = value.getAsArray();
+        if (!headers) {
+            return false;
+        }
+        for (const auto& entry : *headers) {
+            auto* object = entry.getAsObject();
+            if (!object) {
+                return false;
             }
+            auto header = object->getString("header");
+            auto offset = object->getInteger("offset");
+            auto name = object->getString("name");
+            auto* findings = object->get("findings");
+            MyPrint block;
+            if (!header || !offset || *offset < 0 || !name || !findings ||
+                !block.ReadJson(*findings)) {
+                return false;
+            }
+            std::pair<unsigned, std::string> decl{static_cast<unsigned>(*offset), name->str()};
+            headers_[header->str()].try_emplace(decl, block.Since(0, true));
         }
-        if (min < 4 && min > 0) {
-            printer.SetBadNames(
-                {Entity::kVariable, string, filename, number, false, my_dict[min_ind], item});
+        return true;
+    }
+
+private:
+    HeaderReport mode_;                              // NOLINT
+    std::mutex mutex_;                               // NOLINT
+    std::map<Key, std::vector<BadNames>> findings_;  // NOLINT
+    // Only in the kOnce mode: header, (offset, name) -> findings.
+    std::map<std::string, std::map<std::pair<unsigned, std::string>, std::vector<BadNames>>>
+        headers_;  // NOLINT
+};
+
+Dictionary my_dict;
+std::unique_ptr<DictIndex> dict_index;
+std::unique_ptr<SeenDecls> seen_decls;
+// Function bodies are skipped, only declarations that can appear outside of them are checked.
+bool decls_only = false;
+// With -diff or -diff-base, only the declarations on these lines are checked.
+std::unique_ptr<ChangedLines> changed_lines;
+// With -header-filter or -exclude, the files whose declarations are checked.
+std::unique_ptr<PathFilter> path_filter;
+
+void CalcMistake(MyPrint& report, llvm::StringRef string, llvm::StringRef filename,
+                 unsigned int number) {
+    if (my_dict.Empty()) {
+        return;
+    }
+    for (auto item : SplitWords(string)) {
+        if (item.size() <= 3) {
+            continue;
         }
+        report.SetBadNames({Entity::kVariable, string, filename, number, false, "", item});
+    }
+}
+
+// Declarations in system headers are not checked, -run-stats counts them.
+bool IsSkipped(const clang::FullSourceLoc& loc) {
+    if (!loc.isValid()) {
+        return true;
+    }
+    if (!loc.isInSystemHeader()) {
+        return false;
+    }
+    if (run_stats.Enabled()) {
+        run_stats.AddSystemRejection();
+    }
+    return true;
+}
+
+// The name of a declaration, without an allocation if it is a plain identifier.
+llvm::StringRef NameOf(const clang::NamedDecl* decl, std::string& buffer) {
+    if (auto* identifier = decl->getIdentifier()) {
+        return identifier->getName();
     }
+    buffer = decl->getNameAsString();
+    return buffer;
+}
+
+// The path of a file that does not depend on how a unit included it: the real path,
+// absolute and resolved, as the file manager found it or as it is resolved now.
+std::string CanonicalPath(const clang::FileEntry& entry) {
+    llvm::StringRef path = entry.tryGetRealPathName();
+    return path.empty() ? RealPath(entry.getName()) : path.str();
 }
 
 using namespace clang::ast_matchers;  // NOLINT
-// var
-class CallbackForVarDecl : public clang::ast_matchers::MatchFinder::MatchCallback {
+
+// The translation unit a declaration is checked in.
+class UnitInfo {
 public:
-    void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
-        auto* var_decl = result.Nodes.getNodeAs<clang::VarDecl>("var");
-        if (!var_decl) {
-            return;
+    explicit UnitInfo(clang::ASTContext& context) : context_(context) {
+    }
+
+    clang::ASTContext& Context() const {
+        return context_;
+    }
+
+    clang::SourceManager& Sources() const {
+        return context_.getSourceManager();
+    }
+
+    // The main file name, looked up on first use.
+    const std::string& MainFile() {
+        if (main_file_.empty()) {
+            auto& source_manager = context_.getSourceManager();
+            main_file_ = source_manager.getFileEntryRefForID(source_manager.getMainFileID())
+                             .getValue()
+                             .getName()
+                             .str();
         }
-        auto loc = result.Context->getFullLoc(var_decl->getLocation());
-        if (!loc.isValid() || loc.isInSystemHeader()) {
-            return;
+        return main_file_;
+    }
+
+    // Whether the declaration at loc (where it is expanded, in a macro) is to be
+    // checked: its file is not a system header, passes -header-filter and -exclude
+    // and, with a diff, its line is a changed one. System headers are rejected first,
+    // so they are counted as such and never reach the path filter.
+    bool IsSelected(clang::SourceLocation loc) {
+        auto& source_manager = Sources();
+        auto file_loc = source_manager.getFileLoc(loc);
+        if (file_loc.isInvalid()) {
+            return false;
         }
-        if (var_decl->getNameAsString().empty()) {
-            return;
+        if (source_manager.isInSystemHeader(file_loc)) {
+            if (run_stats.Enabled()) {
+                run_stats.AddSystemRejection();
+            }
+            return false;
+        }
+        auto [file_id, offset] = source_manager.getDecomposedLoc(file_loc);
+        const auto& info = Info(file_id);
+        if (info.filtered) {
+            if (run_stats.Enabled()) {
+                run_stats.AddFilterRejection();
+            }
+            return false;
+        }
+        if (!changed_lines) {
+            return true;
+        }
+        unsigned line = source_manager.getLineNumber(file_id, offset);
+        return info.changed && ChangedLines::Contains(*info.changed, line);
+    }
+
+    // Whether the file of loc is dropped by -header-filter or -exclude.
+    bool IsFiltered(clang::SourceLocation loc) {
+        auto file_loc = Sources().getFileLoc(loc);
+        return file_loc.isValid() && Info(Sources().getFileID(file_loc)).filtered;
+    }
+
+    // The canonical path of a file of the unit, empty if it has no file entry.
+    const std::string& Path(clang::FileID file_id) {
+        return Info(file_id).path;
+    }
+
+private:
+    // The path of a file and what the filters say about it, looked up once per file
+    // of the unit.
+    struct FileInfo {
+        bool filtered;
+        std::string path;
+        const std::vector<LineRange>* changed;
+    };
+
+    const FileInfo& Info(clang::FileID file_id) {
+        auto& source_manager = Sources();
+        auto [it, inserted] = files_.try_emplace(file_id, FileInfo{false, {}, nullptr});
+        auto* entry = inserted ? source_manager.getFileEntryForID(file_id) : nullptr;
+        if (entry) {
+            it->second.path = CanonicalPath(*entry);
+            const auto& path = it->second.path;
+            if (path_filter) {
+                it->second.filtered =
+                    !path_filter->Accepts(path, file_id == source_manager.getMainFileID());
+            }
+            if (changed_lines) {
+                it->second.changed = changed_lines->Find(path);
+            }
+        }
+        return it->second;
+    }
+
+    clang::ASTContext& context_;                     // NOLINT
+    std::string main_file_;                          // NOLINT
+    llvm::DenseMap<clang::FileID, FileInfo> files_;  // NOLINT
+};
+
+// Runs the check of a declaration outside of the main file only if no other unit has
+// checked it before, otherwise replays the findings recorded then.
+template <class Check>
+void CheckShared(const clang::NamedDecl* decl, UnitInfo& unit, MyPrint& printer, Check check) {
+    auto& source_manager = unit.Sources();
+    auto file_loc = source_manager.getFileLoc(decl->getLocation());
+    if (!seen_decls || file_loc.isInvalid() || source_manager.isInMainFile(file_loc)) {
+        check();
+        return;
+    }
+    auto [file_id, offset] = source_manager.getDecomposedLoc(file_loc);
+    auto* entry = source_manager.getFileEntryForID(file_id);
+    if (!entry) {
+        check();
+        return;
+    }
+    SeenDecls::Key key{entry->getUniqueID(), offset, decl->getNameAsString()};
+    if (seen_decls->Replay(key, printer)) {
+        return;
+    }
+    auto mark = printer.Mark();
+    check();
+    auto findings = printer.Since(mark, true);
+    // Units may spell the path of a header differently, the findings are named by its
+    // real path so that neither mode depends on which unit checked it first.
+    const auto& header = unit.Path(file_id);
+    for (auto& item : findings) {
+        item.file_name = string_pool.Intern(header);
+    }
+    if (seen_decls->Mode() == HeaderReport::kEach) {
+        for (const auto& item : findings) {
+            printer.SetBadNames(item);
         }
-        auto parent_filename =
-            result.SourceManager->getFileEntryRefForID(result.SourceManager->getMainFileID())
-                .getValue()
-                .getName()
-                .data();
-        printer.SetFileName(parent_filename);
-        auto var_loc = result.SourceManager->isMacroBodyExpansion(loc)
-                           ? result.SourceManager->getImmediateMacroCallerLoc(loc)
+    }
+    seen_decls->Record(key, header, std::move(findings));
+}
+
+// var
+void CheckDecl(const clang::VarDecl* var_decl, UnitInfo& unit, MyPrint& printer) {
+    auto& source_manager = unit.Sources();
+    std::string buffer;
+    auto name = NameOf(var_decl, buffer);
+    auto loc = unit.Context().getFullLoc(var_decl->getLocation());
+    if (IsSkipped(loc)) {
+        return;
+    }
+    if (name.empty()) {
+        return;
+    }
+    // Parameters and local variables are not part of the declarations-only check.
+    if (decls_only && !var_decl->isFileVarDecl()) {
+        return;
+    }
+    printer.SetFileName(unit.MainFile());
+    CheckShared(var_decl, unit, printer, [&] {
+        auto var_loc = source_manager.isMacroBodyExpansion(loc)
+                           ? source_manager.getImmediateMacroCallerLoc(loc)
                            : var_decl->getLocation();
         if (var_decl->isConstexpr() || var_decl->getType().isConstQualified()) {  // const
-            if (!std::regex_match(var_decl->getNameAsString(),
-                                  std::regex(R"(k([A-Z]{1,}[a-z]+)+)"))) {
-                printer.SetBadNames({Entity::kConst, var_decl->getNameAsString(),
-                                     std::string(result.SourceManager->getFilename(var_loc)),
-                                     result.SourceManager->getSpellingLineNumber(var_loc)});
+            if (!MatchesNamingRule(Entity::kConst, name)) {
+                printer.SetBadNames({Entity::kConst, name, source_manager.getFilename(var_loc),
+                                     source_manager.getSpellingLineNumber(var_loc)});
                 return;
             }
         } else if (var_decl->isCXXClassMember()) {
             if (var_decl->getAccess() != clang::AccessSpecifier::AS_public) {  // private
-                if (!std::regex_match(var_decl->getNameAsString(),
-                                      std::regex(R"(([a-z]+\_[a-z]+\_)|([a-z]+\_))"))) {
-                    printer.SetBadNames({Entity::kField, var_decl->getNameAsString(),
-                                         std::string(result.SourceManager->getFilename(var_loc)),
-                                         result.SourceManager->getSpellingLineNumber(var_loc)});
+                if (!MatchesNamingRule(Entity::kField, name)) {
+                    printer.SetBadNames({Entity::kField, name, source_manager.getFilename(var_loc),
+                                         source_manager.getSpellingLineNumber(var_loc)});
                     return;
                 }
             } else {  // no private
-                if (!std::regex_match(var_decl->getNameAsString(),
-                                      std::regex(R"([a-z]+(_[a-z]+)*)"))) {
-                    printer.SetBadNames({Entity::kVariable, var_decl->getNameAsString(),
-                                         std::string(result.SourceManager->getFilename(var_loc)),
-                                         result.SourceManager->getSpellingLineNumber(var_loc)});
+                if (!MatchesNamingRule(Entity::kVariable, name)) {
+                    printer.SetBadNames({Entity::kVariable, name,
+                                         source_manager.getFilename(var_loc),
+                                         source_manager.getSpellingLineNumber(var_loc)});
                     return;
                 }
             }
         } else {  // no const
-            if (!std::regex_match(var_decl->getNameAsString(), std::regex(R"([a-z]+(_[a-z]+)*)"))) {
-                printer.SetBadNames({Entity::kVariable, var_decl->getNameAsString(),
-                                     std::string(result.SourceManager->getFilename(var_loc)),
-                                     result.SourceManager->getSpellingLineNumber(var_loc)});
+            if (!MatchesNamingRule(Entity::kVariable, name)) {
+                printer.SetBadNames({Entity::kVariable, name, source_manager.getFilename(var_loc),
+                                     source_manager.getSpellingLineNumber(var_loc)});
                 return;
             }
         }
-        if (var_decl->getNameAsString().size() > 3) {
-            CalcMistake(var_decl->getNameAsString(),
-                        std::string(result.SourceManager->getFilename(var_loc)),
-                        result.SourceManager->getSpellingLineNumber(var_loc));
+        if (name.size() > 3) {
+            CalcMistake(printer, name, source_manager.getFilename(var_loc),
+                        source_manager.getSpellingLineNumber(var_loc));
         }
-    }
-};
+    });
+}
+
 // field
-class CallbackForFieldDecl : public clang::ast_matchers::MatchFinder::MatchCallback {
-public:
-    void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
-        auto* field_decl = result.Nodes.getNodeAs<clang::FieldDecl>("field");
-        if (!field_decl) {
-            return;
-        }
-        auto field_loc = field_decl->getBeginLoc();
-        auto loc = result.Context->getFullLoc(field_loc);
-        if (!loc.isValid() || loc.isInSystemHeader()) {
-            return;
-        }
-        auto parent_filename =
-            result.SourceManager->getFileEntryRefForID(result.SourceManager->getMainFileID())
-                .getValue()
-                .getName()
-                .data();
-        printer.SetFileName(parent_filename);
+void CheckDecl(const clang::FieldDecl* field_decl, UnitInfo& unit, MyPrint& printer) {
+    auto& source_manager = unit.Sources();
+    std::string buffer;
+    auto name = NameOf(field_decl, buffer);
+    auto field_loc = field_decl->getBeginLoc();
+    auto loc = unit.Context().getFullLoc(field_loc);
+    if (IsSkipped(loc)) {
+        return;
+    }
+    printer.SetFileName(unit.MainFile());
+    CheckShared(field_decl, unit, printer, [&] {
         if (field_decl->getType().isConstQualified()) {  // const
-            if (!std::regex_match(field_decl->getNameAsString(),
-                                  std::regex(R"(k([A-Z]{1,}[a-z]+)+)"))) {
-                printer.SetBadNames({Entity::kConst, field_decl->getNameAsString(),
-                                     std::string(result.SourceManager->getFilename(field_loc)),
-                                     result.SourceManager->getSpellingLineNumber(field_loc)});
+            if (!MatchesNamingRule(Entity::kConst, name)) {
+                printer.SetBadNames({Entity::kConst, name, source_manager.getFilename(field_loc),
+                                     source_manager.getSpellingLineNumber(field_loc)});
                 return;
             }
         } else {                                                                 // no const
             if (field_decl->getAccess() != clang::AccessSpecifier::AS_public) {  // private
-                if (!std::regex_match(field_decl->getNameAsString(),
-                                      std::regex(R"(([a-z]+\_[a-z]+\_)|([a-z]+\_))"))) {
-                    printer.SetBadNames({Entity::kField, field_decl->getNameAsString(),
-                                         std::string(result.SourceManager->getFilename(field_loc)),
-                                         result.SourceManager->getSpellingLineNumber(field_loc)});
+                if (!MatchesNamingRule(Entity::kField, name)) {
+                    printer.SetBadNames({Entity::kField, name,
+                                         source_manager.getFilename(field_loc),
+                                         source_manager.getSpellingLineNumber(field_loc)});
                     return;
                 }
             } else {  // no private
-                if (!std::regex_match(field_decl->getNameAsString(),
-                                      std::regex(R"([a-z]+(_[a-z]+)*)"))) {
-                    printer.SetBadNames({Entity::kVariable, field_decl->getNameAsString(),
-                                         std::string(result.SourceManager->getFilename(field_loc)),
-                                         result.SourceManager->getSpellingLineNumber(field_loc)});
+                if (!MatchesNamingRule(Entity::kVariable, name)) {
+                    printer.SetBadNames({Entity::kVariable, name,
+                                         source_manager.getFilename(field_loc),
+                                         source_manager.getSpellingLineNumber(field_loc)});
                     return;
                 }
             }
         }
-        if (field_decl->getNameAsString().size() > 3) {
-            CalcMistake(field_decl->getNameAsString(),
-                        std::string(result.SourceManager->getFilename(field_loc)),
-                        result.SourceManager->getSpellingLineNumber(field_loc));
+        if (name.size() > 3) {
+            CalcMistake(printer, name, source_manager.getFilename(field_loc),
+                        source_manager.getSpellingLineNumber(field_loc));
         }
-    }
-};
+    });
+}
+
 // function
-class CallbackForFunctionDecl : public clang::ast_matchers::MatchFinder::MatchCallback {
-public:
-    void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
-        auto* function_decl = result.Nodes.getNodeAs<clang::FunctionDecl>("function");
-        if (!function_decl) {
-            return;
-        }
-        auto function_loc = function_decl->getBeginLoc();
-        auto loc = result.Context->getFullLoc(function_loc);
-        if (!loc.isValid() || loc.isInSystemHeader()) {
-            return;
-        }
-        if (function_decl->isMain() || function_decl->isOverloadedOperator()) {
-            return;
-        }
-        auto parent_filename =
-            result.SourceManager->getFileEntryRefForID(result.SourceManager->getMainFileID())
-                .getValue()
-                .getName()
-                .data();
-        printer.SetFileName(parent_filename);
-        std::string name = function_decl->getNameAsString();
+void CheckDecl(const clang::FunctionDecl* function_decl, UnitInfo& unit, MyPrint& printer) {
+    auto& source_manager = unit.Sources();
+    std::string buffer;
+    auto full_name = NameOf(function_decl, buffer);
+    auto function_loc = function_decl->getBeginLoc();
+    auto loc = unit.Context().getFullLoc(function_loc);
+    if (IsSkipped(loc)) {
+        return;
+    }
+    if (function_decl->isMain() || function_decl->isOverloadedOperator()) {
+        return;
+    }
+    printer.SetFileName(unit.MainFile());
+    CheckShared(function_decl, unit, printer, [&] {
+        auto name = full_name;
         if (function_decl->isTemplated()) {
             name = name.substr(0, name.find('<'));
         }
         if (name == "run") {
             return;
         }
-        if (!std::regex_match(name, std::regex(R"(^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$)"))) {
-            printer.SetBadNames({Entity::kFunction, name,
-                                 std::string(result.SourceManager->getFilename(function_loc)),
-                                 result.SourceManager->getSpellingLineNumber(function_loc)});
+        if (!MatchesNamingRule(Entity::kFunction, name)) {
+            printer.SetBadNames({Entity::kFunction, name, source_manager.getFilename(function_loc),
+                                 source_manager.getSpellingLineNumber(function_loc)});
         } else {
-            if (function_decl->getNameAsString().size() > 3) {
-                CalcMistake(function_decl->getNameAsString(),
-                            std::string(result.SourceManager->getFilename(function_loc)),
-                            result.SourceManager->getSpellingLineNumber(function_loc));
+            if (full_name.size() > 3) {
+                CalcMistake(printer, full_name, source_manager.getFilename(function_loc),
+                            source_manager.getSpellingLineNumber(function_loc));
             }
         }
-    }
-};
+    });
+}
 
 // class or struct
-class CallbackForRecordDecl : public clang::ast_matchers::MatchFinder::MatchCallback {
-public:
-    void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
-        auto* record_decl = result.Nodes.getNodeAs<clang::CXXRecordDecl>("record");
-        if (!record_decl) {
-            return;
-        }
-        auto record_loc = record_decl->getBeginLoc();
-        auto loc = result.Context->getFullLoc(record_loc);
-        if (!loc.isValid() || loc.isInSystemHeader()) {
-            return;
-        }
-        if (record_decl->getNameAsString().empty()) {
-            return;
-        }
-        auto parent_filename =
-            result.SourceManager->getFileEntryRefForID(result.SourceManager->getMainFileID())
-                .getValue()
-                .getName()
-                .data();
-        printer.SetFileName(parent_filename);
-        if (!std::regex_match(record_decl->getNameAsString(),
-                              std::regex(R"(^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$)"))) {
-            printer.SetBadNames({Entity::kType, record_decl->getNameAsString(),
-                                 std::string(result.SourceManager->getFilename(record_loc)),
-                                 result.SourceManager->getSpellingLineNumber(record_loc)});
+void CheckDecl(const clang::CXXRecordDecl* record_decl, UnitInfo& unit, MyPrint& printer) {
+    auto& source_manager = unit.Sources();
+    std::string buffer;
+    auto name = NameOf(record_decl, buffer);
+    auto record_loc = record_decl->getBeginLoc();
+    auto loc = unit.Context().getFullLoc(record_loc);
+    if (IsSkipped(loc)) {
+        return;
+    }
+    if (name.empty()) {
+        return;
+    }
+    printer.SetFileName(unit.MainFile());
+    CheckShared(record_decl, unit, printer, [&] {
+        if (!MatchesNamingRule(Entity::kType, name)) {
+            printer.SetBadNames({Entity::kType, name, source_manager.getFilename(record_loc),
+                                 source_manager.getSpellingLineNumber(record_loc)});
         } else {
-            if (record_decl->getNameAsString().size() > 3) {
-                CalcMistake(record_decl->getNameAsString(),
-                            std::string(result.SourceManager->getFilename(record_loc)),
-                            result.SourceManager->getSpellingLineNumber(record_loc));
+            if (name.size() > 3) {
+                CalcMistake(printer, name, source_manager.getFilename(record_loc),
+                            source_manager.getSpellingLineNumber(record_loc));
             }
         }
-    }
-};
+    });
+}
+
 // enum
-class CallbackForEnumDecl : public clang::ast_matchers::MatchFinder::MatchCallback {
-public:
-    void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
-        auto* enum_decl = result.Nodes.getNodeAs<clang::EnumDecl>("enum");
-        if (!enum_decl) {
-            return;
-        }
-        auto parent_filename =
-            result.SourceManager->getFileEntryRefForID(result.SourceManager->getMainFileID())
-                .getValue()
-                .getName()
-                .data();
-        printer.SetFileName(parent_filename);
-        auto enum_loc = enum_decl->getBeginLoc();
-        auto loc = result.Context->getFullLoc(enum_loc);
-        if (!loc.isValid() || loc.isInSystemHeader()) {
-            return;
-        }
-        if (enum_decl->getNameAsString().empty()) {
-            return;
-        }
-        if (!std::regex_match(enum_decl->getNameAsString(),
-                              std::regex(R"(^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$)"))) {
-            printer.SetBadNames({Entity::kType, enum_decl->getNameAsString(),
-                                 std::string(result.SourceManager->getFilename(enum_loc)),
-                                 result.SourceManager->getSpellingLineNumber(enum_loc)});
+void CheckDecl(const clang::EnumDecl* enum_decl, UnitInfo& unit, MyPrint& printer) {
+    auto& source_manager = unit.Sources();
+    std::string buffer;
+    auto name = NameOf(enum_decl, buffer);
+    printer.SetFileName(unit.MainFile());
+    auto enum_loc = enum_decl->getBeginLoc();
+    auto loc = unit.Context().getFullLoc(enum_loc);
+    if (IsSkipped(loc)) {
+        return;
+    }
+    if (name.empty()) {
+        return;
+    }
+    CheckShared(enum_decl, unit, printer, [&] {
+        if (!MatchesNamingRule(Entity::kType, name)) {
+            printer.SetBadNames({Entity::kType, name, source_manager.getFilename(enum_loc),
+                                 source_manager.getSpellingLineNumber(enum_loc)});
         } else {
-            if (enum_decl->getNameAsString().size() > 3) {
-                CalcMistake(enum_decl->getNameAsString(),
-                            std::string(result.SourceManager->getFilename(enum_loc)),
-                            result.SourceManager->getSpellingLineNumber(enum_loc));
+            if (name.size() > 3) {
+                CalcMistake(printer, name, source_manager.getFilename(enum_loc),
+                            source_manager.getSpellingLineNumber(enum_loc));
             }
         }
-    }
-};
+    });
+}
+
 // TypeAlias
-class CallbackForTypeAliasDecl : public clang::ast_matchers::MatchFinder::MatchCallback {
-public:
-    void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
-        auto* alias_decl = result.Nodes.getNodeAs<clang::TypeAliasDecl>("alias");
-        if (!alias_decl) {
-            return;
-        }
-        auto alias_loc = alias_decl->getBeginLoc();
-        auto loc = result.Context->getFullLoc(alias_loc);
-        if (!loc.isValid() || loc.isInSystemHeader()) {
-            return;
-        }
-        if (alias_decl->getNameAsString().empty()) {
-            return;
+void CheckDecl(const clang::TypeAliasDecl* alias_decl, UnitInfo& unit, MyPrint& printer) {
+    auto& source_manager = unit.Sources();
+    std::string buffer;
+    auto name = NameOf(alias_decl, buffer);
+    auto alias_loc = alias_decl->getBeginLoc();
+    auto loc = unit.Context().getFullLoc(alias_loc);
+    if (IsSkipped(loc)) {
+        return;
+    }
+    if (name.empty()) {
+        return;
+    }
+    printer.SetFileName(unit.MainFile());
+    CheckShared(alias_decl, unit, printer, [&] {
+        if (!MatchesNamingRule(Entity::kType, name)) {
+            printer.SetBadNames({Entity::kType, name, source_manager.getFilename(alias_loc),
+                                 source_manager.getSpellingLineNumber(alias_loc)});
+        } else {
+            if (name.size() > 3) {
+                CalcMistake(printer, name, source_manager.getFilename(alias_loc),
+                            source_manager.getSpellingLineNumber(alias_loc));
+            }
         }
-        auto parent_filename =
-            result.SourceManager->getFileEntryRefForID(result.SourceManager->getMainFileID())
-                .getValue()
-                .getName()
-                .data();
-        printer.SetFileName(parent_filename);
-        if (!std::regex_match(alias_decl->getNameAsString(),
-                              std::regex(R"(^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$)"))) {
-            printer.SetBadNames({Entity::kType, alias_decl->getNameAsString(),
-                                 std::string(result.SourceManager->getFilename(alias_loc)),
-                                 result.SourceManager->getSpellingLineNumber(alias_loc)});
+    });
+}
+
+void CheckDecl(const clang::TypedefDecl* type_decl, UnitInfo& unit, MyPrint& printer) {
+    auto& source_manager = unit.Sources();
+    std::string buffer;
+    auto name = NameOf(type_decl, buffer);
+    auto type_loc = type_decl->getBeginLoc();
+    auto loc = unit.Context().getFullLoc(type_loc);
+    if (IsSkipped(loc)) {
+        return;
+    }
+    if (name.empty()) {
+        return;
+    }
+    printer.SetFileName(unit.MainFile());
+    CheckShared(type_decl, unit, printer, [&] {
+        if (!MatchesNamingRule(Entity::kType, name)) {
+            printer.SetBadNames({Entity::kType, name, source_manager.getFilename(type_loc),
+                                 source_manager.getSpellingLineNumber(type_loc)});
         } else {
-            if (alias_decl->getNameAsString().size() > 3) {
-                CalcMistake(alias_decl->getNameAsString(),
-                            std::string(result.SourceManager->getFilename(alias_loc)),
-                            result.SourceManager->getSpellingLineNumber(alias_loc));
+            if (name.size() > 3) {
+                CalcMistake(printer, name, source_manager.getFilename(type_loc),
+                            source_manager.getSpellingLineNumber(type_loc));
             }
         }
+    });
+}
+
+// The -run-stats counter of a declaration type.
+constexpr CheckKind KindOf(const clang::VarDecl*) {
+    return CheckKind::kVar;
+}
+
+constexpr CheckKind KindOf(const clang::FieldDecl*) {
+    return CheckKind::kField;
+}
+
+constexpr CheckKind KindOf(const clang::FunctionDecl*) {
+    return CheckKind::kFunction;
+}
+
+constexpr CheckKind KindOf(const clang::CXXRecordDecl*) {
+    return CheckKind::kRecord;
+}
+
+constexpr CheckKind KindOf(const clang::EnumDecl*) {
+    return CheckKind::kEnum;
+}
+
+constexpr CheckKind KindOf(const clang::TypeAliasDecl*) {
+    return CheckKind::kTypeAlias;
+}
+
+constexpr CheckKind KindOf(const clang::TypedefDecl*) {
+    return CheckKind::kTypeDef;
+}
+
+// CheckDecl, counted and timed with -run-stats on every call of the callback. The
+// declarations in system headers and filtered out files and, with a diff, off the
+// changed lines are dropped before any check.
+template <class T>
+void RunCheck(const T* decl, UnitInfo& unit, MyPrint& printer) {
+    RunStats::Clock::time_point start;
+    if (run_stats.Enabled()) {
+        start = RunStats::Clock::now();
     }
-};
+    if (!(path_filter || changed_lines) || unit.IsSelected(decl->getLocation())) {
+        CheckDecl(decl, unit, printer);
+    }
+    if (run_stats.Enabled()) {
+        run_stats.AddCheck(KindOf(decl), RunStats::Clock::now() - start);
+    }
+}
 
-class CallbackForTypeDefDecl : public clang::ast_matchers::MatchFinder::MatchCallback {
+// Runs the check for the node bound to id. The callbacks of a checker share the unit,
+// created on the first match of a translation unit and dropped when the checker
+// starts the next one, so the main file and the verdicts on the other files are
+// looked up once per unit.
+template <class T>
+class CheckCallback : public clang::ast_matchers::MatchFinder::MatchCallback {
 public:
+    CheckCallback(MyPrint& printer, std::optional<UnitInfo>& unit, std::string id)
+        : printer_(printer), unit_(unit), id_(std::move(id)) {
+    }
+
     void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
-        auto* type_decl = result.Nodes.getNodeAs<clang::TypedefDecl>("decl");
-        if (!type_decl) {
-            return;
-        }
-        auto type_loc = type_decl->getBeginLoc();
-        auto loc = result.Context->getFullLoc(type_loc);
-        if (!loc.isValid() || loc.isInSystemHeader()) {
-            return;
-        }
-        if (type_decl->getNameAsString().empty()) {
-            return;
-        }
-        auto parent_filename =
-            result.SourceManager->getFileEntryRefForID(result.SourceManager->getMainFileID())
-                .getValue()
-                .getName()
-                .data();
-        printer.SetFileName(parent_filename);
-        if (!std::regex_match(type_decl->getNameAsString(),
-                              std::regex(R"(^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$)"))) {
-            printer.SetBadNames({Entity::kType, type_decl->getNameAsString(),
-                                 std::string(result.SourceManager->getFilename(type_loc)),
-                                 result.SourceManager->getSpellingLineNumber(type_loc)});
-        } else {
-            if (type_decl->getNameAsString().size() > 3) {
-                CalcMistake(type_decl->getNameAsString(),
-                            std::string(result.SourceManager->getFilename(type_loc)),
-                            result.SourceManager->getSpellingLineNumber(type_loc));
+        if (auto* decl = result.Nodes.getNodeAs<T>(id_)) {
+            if (!unit_) {
+                unit_.emplace(*result.Context);
             }
+            RunCheck(decl, *unit_, printer_);
         }
     }
-};
 
-int main(int argc, const char** argv) {
-    llvm::cl::OptionCategory category{"my category"};
+private:
+    MyPrint& printer_;               // NOLINT
+    std::optional<UnitInfo>& unit_;  // NOLINT
+    std::string id_;                 // NOLINT
+};
 
-    llvm::cl::opt<std::string> dict{"dict", llvm::cl::cat{category}};
+using CallbackForVarDecl = CheckCallback<clang::VarDecl>;
+using CallbackForFieldDecl = CheckCallback<clang::FieldDecl>;
+using CallbackForFunctionDecl = CheckCallback<clang::FunctionDecl>;
+using CallbackForRecordDecl = CheckCallback<clang::CXXRecordDecl>;
+using CallbackForEnumDecl = CheckCallback<clang::EnumDecl>;
+using CallbackForTypeAliasDecl = CheckCallback<clang::TypeAliasDecl>;
+using CallbackForTypeDefDecl = CheckCallback<clang::TypedefDecl>;
 
-    auto expected_parser = clang::tooling::CommonOptionsParser::create(argc, argv, category);
+// The non-system files the unit has read, the main file included.
+std::vector<std::string> CollectDependencies(const clang::SourceManager& source_manager) {
+    std::vector<std::string> files;
+    for (unsigned i = 0; i < source_manager.local_sloc_entry_size(); ++i) {
+        const auto& entry = source_manager.getLocalSLocEntry(i);
+        if (!entry.isFile() || clang::SrcMgr::isSystem(entry.getFile().getFileCharacteristic())) {
+            continue;
+        }
+        const clang::FileEntry* file = entry.getFile().getContentCache().OrigEntry;
+        if (!file) {
+            continue;
+        }
+        auto real_path = file->tryGetRealPathName();
+        files.push_back((real_path.empty() ? file->getName() : real_path).str());
+    }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+    return files;
+}
 
-    if (!expected_parser) {
-        llvm::errs() << expected_parser.takeError() << '\n';
-        return 1;
+class DependencyCallback : public clang::ast_matchers::MatchFinder::MatchCallback {
+public:
+    explicit DependencyCallback(std::vector<std::string>* dependencies)
+        : dependencies_(dependencies) {
     }
 
-    auto& parser = *expected_parser;
-    clang::tooling::ClangTool tool{parser.getCompilations(), parser.getSourcePathList()};
+    void run(const clang::ast_matchers::MatchFinder::MatchResult& result) override {
+        *dependencies_ = CollectDependencies(*result.SourceManager);
+    }
 
+private:
+    std::vector<std::string>* dependencies_;  // NOLINT
+};
+
+// The matchers and callbacks of one run, reporting into one printer. The files the
+// unit has read are stored into dependencies, if it is given.
+class NameChecker {
+public:
+    explicit NameChecker(MyPrint& printer, std::vector<std::string>* dependencies = nullptr)
+        : callback_dependencies_(dependencies),
+          callback_var_(printer, unit_, "var"),
+          callback_field_(printer, unit_, "field"),
+          callback_function_(printer, unit_, "function"),
+          callback_record_(printer, unit_, "record"),
+          callback_enum_(printer, unit_, "enum"),
+          callback_alias_(printer, unit_, "alias"),
+          callback_decl_(printer, unit_, "decl") {
+        auto matcher_var = varDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("var");
+        auto matcher_field = fieldDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("field");
+        auto matcher_function =
+            functionDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("function");
+        auto matcher_record =
+            cxxRecordDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("record");
+        auto matcher_enum = enumDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("enum");
+        auto matcher_alias =
+            typeAliasDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("alias");
+        auto matcher_decl = typedefDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("decl");
+        finder_.addMatcher(matcher_var, &callback_var_);
+        finder_.addMatcher(matcher_field, &callback_field_);
+        finder_.addMatcher(matcher_function, &callback_function_);
+        finder_.addMatcher(matcher_record, &callback_record_);
+        finder_.addMatcher(matcher_enum, &callback_enum_);
+        finder_.addMatcher(matcher_alias, &callback_alias_);
+        finder_.addMatcher(matcher_decl, &callback_decl_);
+        if (dependencies) {
+            finder_.addMatcher(translationUnitDecl(), &callback_dependencies_);
+        }
+    }
+
+    // The consumer of the next translation unit, which gets a unit of its own.
+    std::unique_ptr<clang::ASTConsumer> NewConsumer() {
+        unit_.reset();
+        return finder_.newASTConsumer();
+    }
+
+private:
+    std::optional<UnitInfo> unit_;               // NOLINT
+    DependencyCallback callback_dependencies_;   // NOLINT
+    CallbackForVarDecl callback_var_;            // NOLINT
+    CallbackForFieldDecl callback_field_;        // NOLINT
+    CallbackForFunctionDecl callback_function_;  // NOLINT
+    CallbackForRecordDecl callback_record_;      // NOLINT
+    CallbackForEnumDecl callback_enum_;          // NOLINT
+    CallbackForTypeAliasDecl callback_alias_;    // NOLINT
+    CallbackForTypeDefDecl callback_decl_;       // NOLINT
+    clang::ast_matchers::MatchFinder finder_;    // NOLINT
+};
+
+// The visitor engine: one traversal per translation unit that dispatches to the
+// same checks. Declarations located in system headers are skipped together with
+// everything inside them, so the standard library is never walked. Implicit
+// template instantiations are not visited, the explicit ones are skipped like the
+// matchers do.
+class NameVisitor : public clang::RecursiveASTVisitor<NameVisitor> {
+public:
+    NameVisitor(clang::ASTContext& context, MyPrint& printer) : unit_(context), printer_(printer) {
+    }
+
+    UnitInfo& Unit() {
+        return unit_;
+    }
+
+    bool TraverseDecl(clang::Decl* decl) {
+        if (decl && !llvm::isa<clang::TranslationUnitDecl>(decl) && decl->getLocation().isValid() &&
+            unit_.Sources().isInSystemHeader(decl->getLocation())) {
+            if (run_stats.Enabled()) {
+                run_stats.AddSystemRejection();
+            }
+            return true;
+        }
+        // The contents of a filtered out file are not traversed either.
+        if (path_filter && decl && !llvm::isa<clang::TranslationUnitDecl>(decl) &&
+            decl->getLocation().isValid() && unit_.IsFiltered(decl->getLocation())) {
+            if (run_stats.Enabled()) {
+                run_stats.AddFilterRejection();
+            }
+            return true;
+        }
+        return clang::RecursiveASTVisitor<NameVisitor>::TraverseDecl(decl);
+    }
+
+    bool VisitVarDecl(clang::VarDecl* var_decl) {
+        if (!var_decl->isImplicit() &&
+            !clang::isTemplateInstantiation(var_decl->getTemplateSpecializationKind())) {
+            RunCheck(var_decl, unit_, printer_);
+        }
+        return true;
+    }
+
+    bool VisitFieldDecl(clang::FieldDecl* field_decl) {
+        if (!field_decl->isImplicit()) {
+            RunCheck(field_decl, unit_, printer_);
+        }
+        return true;
+    }
+
+    bool VisitFunctionDecl(clang::FunctionDecl* function_decl) {
+        if (!function_decl->isImplicit() &&
+            !clang::isTemplateInstantiation(function_decl->getTemplateSpecializationKind())) {
+            RunCheck(function_decl, unit_, printer_);
+        }
+        return true;
+    }
+
+    bool VisitCXXRecordDecl(clang::CXXRecordDecl* record_decl) {
+        if (!record_decl->isImplicit() &&
+            !clang::isTemplateInstantiation(record_decl->getTemplateSpecializationKind())) {
+            RunCheck(record_decl, unit_, printer_);
+        }
+        return true;
+    }
+
+    bool VisitEnumDecl(clang::EnumDecl* enum_decl) {
+        if (!enum_decl->isImplicit()) {
+            RunCheck(enum_decl, unit_, printer_);
+        }
+        return true;
+    }
+
+    bool VisitTypeAliasDecl(clang::TypeAliasDecl* alias_decl) {
+        if (!alias_decl->isImplicit()) {
+            RunCheck(alias_decl, unit_, printer_);
+        }
+        return true;
+    }
+
+    bool VisitTypedefDecl(clang::TypedefDecl* type_decl) {
+        if (!type_decl->isImplicit()) {
+            RunCheck(type_decl, unit_, printer_);
+        }
+        return true;
+    }
+
+private:
+    UnitInfo unit_;     // NOLINT
+    MyPrint& printer_;  // NOLINT
+};
+
+class NameVisitorConsumer : public clang::ASTConsumer {
+public:
+    NameVisitorConsumer(MyPrint& printer, std::vector<std::string>* dependencies)
+        : printer_(printer), dependencies_(dependencies) {
+    }
+
+    void HandleTranslationUnit(clang::ASTContext& context) override {
+        NameVisitor visitor(context, printer_);
+        printer_.SetFileName(visitor.Unit().MainFile());
+        visitor.TraverseDecl(context.getTranslationUnitDecl());
+        if (dependencies_) {
+            *dependencies_ = CollectDependencies(context.getSourceManager());
+        }
+    }
+
+private:
+    MyPrint& printer_;                        // NOLINT
+    std::vector<std::string>* dependencies_;  // NOLINT
+};
+
+// The times of a unit for -run-stats. The parse ends when the consumers get the
+// translation unit, the traversal when the last of them is done with it.
+struct UnitSpan {
+    std::string file;
+    RunStats::Clock::time_point parse_start;
+    RunStats::Clock::time_point match_start;
+};
+
+// Put before and after the consumer of the engine in a MultiplexConsumer.
+class UnitTimer : public clang::ASTConsumer {
+public:
+    UnitTimer(std::shared_ptr<UnitSpan> span, bool last) : span_(std::move(span)), last_(last) {
+    }
+
+    void HandleTranslationUnit(clang::ASTContext&) override {
+        auto now = RunStats::Clock::now();
+        if (!last_) {
+            span_->match_start = now;
+            return;
+        }
+        run_stats.AddUnit(span_->file, span_->parse_start, span_->match_start, now);
+    }
+
+private:
+    std::shared_ptr<UnitSpan> span_;  // NOLINT
+    bool last_;                       // NOLINT
+};
+
+// Put after the consumer of the engine: the memory of the AST and of the sources,
+// which makes most of what a unit holds, for the scheduler.
+class UnitMemory : public clang::ASTConsumer {
+public:
+    explicit UnitMemory(uint64_t& bytes) : bytes_(bytes) {
+    }
+
+    void HandleTranslationUnit(clang::ASTContext& context) override {
+        auto& sources = context.getSourceManager();
+        bytes_ = context.getASTAllocatedMemory() + context.getSideTableAllocatedMemory() +
+                 sources.getContentCacheSize() + sources.getDataStructureSizes() +
+                 sources.getMemoryBufferSizes().malloc_bytes;
+    }
+
+private:
+    uint64_t& bytes_;  // NOLINT
+};
+
+// Where the actions of the current thread report to. Without a checker the units
+// are checked by the visitor engine.
+thread_local MyPrint* current_printer = nullptr;
+thread_local std::vector<std::string>* current_dependencies = nullptr;
+thread_local NameChecker* current_checker = nullptr;
+thread_local uint64_t* current_memory = nullptr;
+
+class CheckAction : public clang::ASTFrontendAction {
+public:
+    std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance&,
+                                                          llvm::StringRef file) override {
+        std::unique_ptr<clang::ASTConsumer> consumer;
+        if (current_checker) {
+            consumer = current_checker->NewConsumer();
+        } else {
+            consumer =
+                std::make_unique<NameVisitorConsumer>(*current_printer, current_dependencies);
+        }
+        if (!run_stats.Enabled() && !current_memory) {
+            return consumer;
+        }
+        std::vector<std::unique_ptr<clang::ASTConsumer>> consumers;
+        std::shared_ptr<UnitSpan> span;
+        if (run_stats.Enabled()) {
+            span = std::make_shared<UnitSpan>(UnitSpan{file.str(), RunStats::Clock::now(), {}});
+            consumers.push_back(std::make_unique<UnitTimer>(span, false));
+        }
+        consumers.push_back(std::move(consumer));
+        if (span) {
+            consumers.push_back(std::make_unique<UnitTimer>(span, true));
+        }
+        if (current_memory) {
+            consumers.push_back(std::make_unique<UnitMemory>(*current_memory));
+        }
+        return std::make_unique<clang::MultiplexConsumer>(std::move(consumers));
+    }
+};
+
+enum class Engine { kMatcher, kVisitor, kLexer };
+
+enum class UnitOrder { kLargestFirst, kSources };
+
+// Returns the status of ClangTool::run. The memory of the unit is stored into memory.
+int RunEngine(Engine engine, clang::tooling::ClangTool& tool, MyPrint& report,
+              std::vector<std::string>* dependencies = nullptr, uint64_t* memory = nullptr) {
+    if (decls_only) {
+        tool.appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+            {"-Xclang", "-skip-function-bodies"}, clang::tooling::ArgumentInsertPosition::END));
+    }
+    std::optional<NameChecker> checker;
+    if (engine == Engine::kMatcher) {
+        checker.emplace(report, dependencies);
+    }
+    current_printer = &report;
+    current_dependencies = dependencies;
+    current_checker = checker ? &*checker : nullptr;
+    current_memory = memory;
+    return tool.run(clang::tooling::newFrontendActionFactory<CheckAction>().get());
+}
+
+// The compile command of a unit as a string, for the result cache key.
+std::string CommandKey(const clang::tooling::CompilationDatabase& compilations,
+                       const std::string& file) {
+    std::string key;
+    for (const auto& command : compilations.getCompileCommands(file)) {
+        key.append(command.Directory).append("\n");
+        for (const auto& arg : command.CommandLine) {
+            key.append(arg).append(" ");
+        }
+        key.append("\n");
+    }
+    return key;
+}
+
+// The directory relative dependencies of a unit are resolved against.
+std::string CommandDirectory(const clang::tooling::CompilationDatabase& compilations,
+                             const std::string& file) {
+    auto commands = compilations.getCompileCommands(file);
+    return commands.empty() ? std::string() : commands.front().Directory;
+}
+
+// How the units of a run are checked, the same for every request of -serve.
+struct RunSettings {
+    unsigned jobs;
+    Engine engine;
+    HeaderReport header_report;
+    ResultCache* cache;
+    // The units are parsed with the first one that fits, if any.
+    const std::vector<std::unique_ptr<SharedPreamble>>* preambles;
+    // The costs of the units, the checked ones are recorded.
+    UnitCosts* costs;
+    // The units expected to take longest are started first.
+    bool largest_first;
+    // The memory the running units may take together (0: no limit).
+    uint64_t memory_budget;
+};
+
+// The contents of files not saved yet (by -serve clients), by path.
+using UnsavedFiles = std::map<std::string, std::string>;
+
+const SharedPreamble* FindPreamble(const clang::tooling::CompilationDatabase& compilations,
+                                   const RunSettings& settings, const std::string& file) {
+    // The lexer engine does not parse.
+    if (settings.preambles && settings.engine != Engine::kLexer) {
+        for (const auto& preamble : *settings.preambles) {
+            if (preamble->Fits(compilations, file)) {
+                return preamble.get();
+            }
+        }
+    }
+    return nullptr;
+}
+
+// The tokens of a file for the lexer engine and the names of its #include "..."
+// lines, with their offsets. The other directives are dropped.
+struct LexedFile {
+    std::vector<ScanToken> tokens;
+    std::vector<std::pair<unsigned, std::string>> includes;
+};
+
+// Runs the raw Clang lexer, which neither expands macros nor reads includes. The
+// contents must end with a null character, as those of a MemoryBuffer do.
+void LexFile(llvm::StringRef contents, LexedFile& file) {
+    clang::LangOptions options;
+    options.CPlusPlus = options.CPlusPlus11 = options.CPlusPlus14 = options.CPlusPlus17 = true;
+    options.LineComment = true;
+    options.Bool = true;
+    clang::Lexer lexer(clang::SourceLocation(), options, contents.begin(), contents.begin(),
+                       contents.end());
+    clang::Token token;
+    unsigned line = 1;
+    const char* counted = contents.begin();
+    // The index of the token in the directive it is in, 0 outside of directives.
+    size_t directive = 0;
+    bool is_include = false;
+    // The raw lexer tells that the end is reached along with the last token.
+    bool done = false;
+    while (!done) {
+        done = lexer.LexFromRawLexer(token);
+        if (token.is(clang::tok::eof)) {
+            break;
+        }
+        const char* start = lexer.getBufferLocation() - token.getLength();
+        line += std::count(counted, start, '\n');
+        counted = start;
+        if (token.isAtStartOfLine()) {
+            directive = token.is(clang::tok::hash) ? 1 : 0;
+        } else if (directive != 0) {
+            ++directive;
+        }
+        if (directive == 2) {
+            is_include =
+                token.is(clang::tok::raw_identifier) && token.getRawIdentifier() == "include";
+        } else if (directive == 3 && is_include && token.is(clang::tok::string_literal)) {
+            llvm::StringRef name(start, token.getLength());
+            file.includes.emplace_back(start - contents.begin(),
+                                       name.drop_front().drop_back().str());
+        } else if (directive != 0) {
+            continue;
+        } else if (token.is(clang::tok::raw_identifier)) {
+            file.tokens.push_back({TokenKind::kIdentifier, token.getRawIdentifier(),
+                                   static_cast<unsigned>(start - contents.begin()), line});
+        } else {
+            file.tokens.push_back({token.isLiteral() ? TokenKind::kLiteral
+                                                     : TokenKind::kPunctuation,
+                                   llvm::StringRef(start, token.getLength()),
+                                   static_cast<unsigned>(start - contents.begin()), line});
+        }
+    }
+}
+
+// The checks of CheckDecl for a declaration the lexer engine has found.
+void CheckScanned(const ScannedDecl& decl, llvm::StringRef file, MyPrint& printer) {
+    llvm::StringRef name = decl.name;
+    auto entity = Entity::kType;
+    if (decl.kind == CheckKind::kVar || decl.kind == CheckKind::kField) {
+        if (decl.is_const) {
+            entity = Entity::kConst;
+        } else if (decl.is_member && !decl.is_public) {
+            entity = Entity::kField;
+        } else {
+            entity = Entity::kVariable;
+        }
+    } else if (decl.kind == CheckKind::kFunction) {
+        if (name == "run") {
+            return;
+        }
+        entity = Entity::kFunction;
+    }
+    if (!MatchesNamingRule(entity, name)) {
+        printer.SetBadNames({entity, name, file, decl.line});
+    } else if (name.size() > 3) {
+        CalcMistake(printer, name, file, decl.line);
+    }
+}
+
+// The lexer engine for one unit: the main file and the headers it includes with
+// quotes, found in the directory of the including file and in the -iquote and -I
+// ones, are lexed and scanned once each. The declarations of a header are checked
+// where it is included, in the order of the unit, and are shared with the other
+// units like the AST engines share them. Headers included with angle brackets are
+// taken for system ones and skipped.
+class LexerUnit {
+public:
+    LexerUnit(std::string main_file, std::vector<std::string> dirs, const UnsavedFiles& unsaved,
+              MyPrint& printer)
+        : main_file_(std::move(main_file)),
+          dirs_(std::move(dirs)),
+          unsaved_(unsaved),
+          printer_(printer) {
+    }
+
+    // Returns false if the main file cannot be read.
+    bool Scan() {
+        return ScanFile(main_file_, true);
+    }
+
+    // The files read, by their real paths.
+    std::vector<std::string> Dependencies() const {
+        return {visited_.begin(), visited_.end()};
+    }
+
+    // The size of the files read.
+    uint64_t Memory() const {
+        return memory_;
+    }
+
+    RunStats::Clock::duration LexTime() const {
+        return lex_time_;
+    }
+
+private:
+    bool ScanFile(const std::string& path, bool is_main) {
+        auto real = RealPath(path);
+        visited_.insert(real);
+        std::unique_ptr<llvm::MemoryBuffer> buffer;
+        auto it = unsaved_.find(path);
+        if (it != unsaved_.end()) {
+            buffer = llvm::MemoryBuffer::getMemBuffer(it->second, path);
+        } else if (auto file = llvm::MemoryBuffer::getFile(path)) {
+            buffer = std::move(*file);
+        } else {
+            llvm::errs() << path << ": " << file.getError().message() << '\n';
+            return false;
+        }
+        memory_ += buffer->getBufferSize();
+        auto lex_start = RunStats::Clock::now();
+        LexedFile lexed;
+        LexFile(buffer->getBuffer(), lexed);
+        auto decls = DeclScanner(lexed.tokens, decls_only).Scan();
+        lex_time_ += RunStats::Clock::now() - lex_start;
+
+        bool filtered = path_filter && !path_filter->Accepts(real, is_main);
+        const std::vector<LineRange>* changed = changed_lines ? changed_lines->Find(real) : nullptr;
+        llvm::sys::fs::UniqueID id;
+        bool shared = seen_decls && !is_main && !llvm::sys::fs::getUniqueID(path, id);
+        auto include = lexed.includes.begin();
+        for (const auto& decl : decls) {
+            for (; include != lexed.includes.end() && include->first < decl.offset; ++include) {
+                Include(path, include->second);
+            }
+            // Every scanned declaration is counted, as a callback call of the AST engines.
+            RunStats::Clock::time_point start;
+            if (run_stats.Enabled()) {
+                start = RunStats::Clock::now();
+            }
+            if (filtered) {
+                if (run_stats.Enabled()) {
+                    run_stats.AddFilterRejection();
+                }
+            } else if (!changed_lines ||
+                       (changed && ChangedLines::Contains(*changed, decl.name_line))) {
+                printer_.SetFileName(main_file_);
+                if (!shared) {
+                    CheckScanned(decl, path, printer_);
+                } else {
+                    SeenDecls::Key key{id, decl.offset, decl.name};
+                    if (!seen_decls->Replay(key, printer_)) {
+                        auto mark = printer_.Mark();
+                        bool take = seen_decls->Mode() == HeaderReport::kOnce;
+                        // As in CheckShared, the findings name the header by its real path.
+                        CheckScanned(decl, real, printer_);
+                        seen_decls->Record(key, real, printer_.Since(mark, take));
+                    }
+                }
+            }
+            if (run_stats.Enabled()) {
+                run_stats.AddCheck(decl.kind, RunStats::Clock::now() - start);
+            }
+        }
+        for (; include != lexed.includes.end(); ++include) {
+            Include(path, include->second);
+        }
+        return true;
+    }
+
+    void Include(const std::string& includer, const std::string& name) {
+        std::vector<std::string> dirs{llvm::sys::path::parent_path(includer).str()};
+        dirs.insert(dirs.end(), dirs_.begin(), dirs_.end());
+        for (const auto& dir : dirs) {
+            llvm::SmallString<256> path(dir);
+            llvm::sys::path::append(path, name);
+            if (llvm::sys::fs::is_regular_file(path)) {
+                if (visited_.count(RealPath(path)) == 0) {
+                    ScanFile(path.str().str(), false);
+                }
+                return;
+            }
+        }
+    }
+
+    std::string main_file_;                 // NOLINT
+    std::vector<std::string> dirs_;         // NOLINT
+    const UnsavedFiles& unsaved_;           // NOLINT
+    MyPrint& printer_;                      // NOLINT
+    std::set<std::string> visited_;         // NOLINT
+    uint64_t memory_ = 0;                   // NOLINT
+    RunStats::Clock::duration lex_time_{};  // NOLINT
+};
+
+// Checks a unit with the lexer engine. Returns the status like RunEngine does: 1 if
+// the main file cannot be read.
+int ScanUnit(const clang::tooling::CompilationDatabase& compilations, const std::string& file,
+             const UnsavedFiles& unsaved, MyPrint& report,
+             std::vector<std::string>* dependencies = nullptr, uint64_t* memory = nullptr) {
+    auto start = RunStats::Clock::now();
+    auto commands = compilations.getCompileCommands(file);
+    // The main file is named as ClangTool names it.
+    llvm::SmallString<256> path(file);
+    llvm::sys::fs::make_absolute(path);
+    llvm::sys::path::remove_dots(path, true);
+    LexerUnit unit(path.str().str(), commands.empty() ? std::vector<std::string>()
+                                                      : IncludeDirs(commands.front()),
+                   unsaved, report);
+    if (!unit.Scan()) {
+        return 1;
+    }
+    if (dependencies) {
+        *dependencies = unit.Dependencies();
+    }
+    if (memory) {
+        *memory = unit.Memory();
+    }
+    if (run_stats.Enabled()) {
+        run_stats.AddUnit(path.str().str(), start, start + unit.LexTime(), RunStats::Clock::now());
+    }
+    return 0;
+}
+
+// Every translation unit gets its own tool, matchers and printer. The printers are
+// passed to the stream in the order of the source list as soon as all the units
+// before them are done, so the report is the same whatever the scheduling. With a
+// cache, the units whose result is still valid are not parsed at all, the others
+// store theirs if the tool succeeded. The units that fit a shared preamble are
+// parsed with it first, and without it if that fails. Neither the cache nor the
+// preambles know the unsaved contents, so a run with some does without both. The
+// lexer engine reads the files itself and has no use for the preambles.
+//
+// With costs, the units expected to take longest start first, so that a large one
+// does not run alone at the end, and a unit starts only when the expected memory of
+// the running ones and its own fits into the budget (a unit larger than the budget
+// runs alone).
+void RunUnits(const clang::tooling::CompilationDatabase& compilations,
+              const std::vector<std::string>& files, const RunSettings& settings,
+              const UnsavedFiles& unsaved, const std::function<void(MyPrint&&)>& emit) {
+    std::vector<MyPrint> reports(files.size());
+    std::vector<bool> done(files.size());
+    std::vector<double> durations(files.size());
+    size_t next = 0;
+    size_t running = 0;
+    uint64_t reserved = 0;
+    std::mutex mutex;
+    std::condition_variable released;
+    auto finish = [&](size_t i, uint64_t memory) {
+        {
+            std::lock_guard lock(mutex);
+            --running;
+            reserved -= memory;
+        }
+        released.notify_one();
+        std::lock_guard lock(mutex);
+        done[i] = true;
+        for (; next < files.size() && done[next]; ++next) {
+            emit(std::move(reports[next]));
+        }
+    };
+    ResultCache* cache = unsaved.empty() ? settings.cache : nullptr;
+    auto check = [&compilations, &files, &settings, &unsaved, &reports, cache](size_t i) {
+        std::string key;
+        if (cache) {
+            key = cache->Key(CommandKey(compilations, files[i]), files[i]);
+            auto cached = cache->Load(key);
+            if (cached && reports[i].ReadJson(*cached)) {
+                return;
+            }
+            reports[i] = MyPrint();
+        }
+        auto start = std::chrono::steady_clock::now();
+        const SharedPreamble* preamble =
+            unsaved.empty() ? FindPreamble(compilations, settings, files[i]) : nullptr;
+        std::vector<std::string> dependencies;
+        uint64_t memory = 0;
+        auto run = [&](bool use_preamble) {
+            if (settings.engine == Engine::kLexer) {
+                return ScanUnit(compilations, files[i], unsaved, reports[i],
+                                cache ? &dependencies : nullptr,
+                                settings.costs ? &memory : nullptr);
+            }
+            // A file system per tool, so that each one has its own working directory.
+            clang::tooling::ClangTool tool{compilations, {files[i]},
+                                           std::make_shared<clang::PCHContainerOperations>(),
+                                           llvm::vfs::createPhysicalFileSystem()};
+            for (const auto& [path, contents] : unsaved) {
+                tool.mapVirtualFile(path, contents);
+            }
+            if (use_preamble) {
+                tool.appendArgumentsAdjuster(preamble->Adjuster());
+            }
+            return RunEngine(settings.engine, tool, reports[i], cache ? &dependencies : nullptr,
+                             settings.costs ? &memory : nullptr);
+        };
+        int status = run(preamble != nullptr);
+        if (preamble && status != 0) {
+            reports[i] = MyPrint();
+            dependencies.clear();
+            status = run(false);
+        }
+        if (cache && status == 0 && !dependencies.empty()) {
+            cache->Store(key, dependencies, CommandDirectory(compilations, files[i]),
+                         reports[i].ToJson());
+        }
+        if (settings.costs && unsaved.empty()) {
+            std::chrono::duration<double, std::milli> spent =
+                std::chrono::steady_clock::now() - start;
+            settings.costs->Record(files[i], {spent.count(), memory});
+        }
+    };
+
+    std::vector<size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<UnitCost> costs(files.size(), UnitCost{0, 0});
+    if (settings.costs) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            costs[i] = settings.costs->Get(files[i]);
+        }
+        if (settings.largest_first) {
+            std::stable_sort(order.begin(), order.end(), [&costs](size_t lhs, size_t rhs) {
+                return costs[lhs].ms > costs[rhs].ms;
+            });
+        }
+    }
+    llvm::ThreadPool pool(llvm::hardware_concurrency(settings.jobs));
+    unsigned threads = pool.getThreadCount();
+    auto run_start = std::chrono::steady_clock::now();
+    for (size_t i : order) {
+        uint64_t memory = settings.memory_budget ? costs[i].memory : 0;
+        {
+            std::unique_lock lock(mutex);
+            released.wait(lock, [&] {
+                return running < threads &&
+                       (running == 0 || reserved + memory <= settings.memory_budget);
+            });
+            ++running;
+            reserved += memory;
+        }
+        pool.async([&check, &finish, &durations, i, memory] {
+            auto start = std::chrono::steady_clock::now();
+            check(i);
+            durations[i] =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                    .count();
+            finish(i, memory);
+        });
+    }
+    pool.wait();
+    if (run_stats.Enabled()) {
+        std::vector<double> planned;
+        for (size_t i : order) {
+            planned.push_back(durations[i]);
+        }
+        std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() -
+                                                         run_start;
+        run_stats.AddSchedule(wall.count(), Makespan(durations, threads),
+                              Makespan(planned, threads));
+    }
+}
+
+// The reporter of a format with the report stream in front of it.
+class ReportOutput {
+public:
+    ReportOutput(ReportFormat format, TypoStage& typo_stage, llvm::raw_ostream& os)
+        : text_(os), json_lines_(os), stream_(Select(format, os), typo_stage, my_dict) {
+    }
+
+    void Add(MyPrint&& report) {
+        stream_.Add(std::move(report));
+    }
+
+    // Adds the header section of seen_decls and ends the report.
+    void Finish() {
+        MyPrint headers;
+        seen_decls->AppendHeaders(headers);
+        stream_.Add(std::move(headers));
+        stream_.Finish();
+    }
+
+private:
+    Reporter& Select(ReportFormat format, llvm::raw_ostream& os) {
+        if (format == ReportFormat::kJsonLines) {
+            return json_lines_;
+        }
+        if (format == ReportFormat::kSarif) {
+            return sarif_.emplace(os);
+        }
+        return text_;
+    }
+
+    TextReporter text_;                   // NOLINT
+    JsonLinesReporter json_lines_;        // NOLINT
+    std::optional<SarifReporter> sarif_;  // NOLINT
+    ReportStream stream_;                 // NOLINT
+};
+
+// Checks the units and writes the report. Every call starts with no declarations
+// seen, so the headers are checked and reported anew each time. The findings are all
+// reported when it returns, their strings are freed then, so a server does not grow
+// from one request to the next.
+void CheckFiles(const clang::tooling::CompilationDatabase& compilations,
+                const std::vector<std::string>& files, const RunSettings& settings,
+                const UnsavedFiles& unsaved, ReportFormat format, TypoStage& typo_stage,
+                llvm::raw_ostream& os) {
+    seen_decls = std::make_unique<SeenDecls>(settings.header_report);
+    {
+        ReportOutput output(format, typo_stage, os);
+        RunUnits(compilations, files, settings, unsaved,
+                 [&output](MyPrint&& report) { output.Add(std::move(report)); });
+        output.Finish();
+    }
+    seen_decls.reset();
+    string_pool.Clear();
+}
+
+// Bump whenever the content of a shard file changes.
+constexpr int kShardFormatVersion = 1;
+
+// The shard of a unit of a -shard run, by its path as given, so that it does not
+// depend on the order of the sources.
+size_t ShardOf(const std::string& file, size_t shards) {
+    return llvm::xxHash64(file) % shards;
+}
+
+std::string DictHash() {
+    std::string words;
+    for (size_t i = 0; i < my_dict.Size(); ++i) {
+        words.append(my_dict[i]).append("\n");
+    }
+    return llvm::utohexstr(llvm::xxHash64(words));
+}
+
+// check_names -shard i/N -shard-output <file>: checks the units of shard i and
+// writes their findings, before the typo stage, with their positions in the source
+// list. The units of every shard are picked from the same list, so --merge puts the
+// findings back in the order of a single run, and in the -header-report=once mode
+// joins the header sections of the shards. config holds the options the findings
+// depend on, the shards of one run must agree on it.
+int RunShard(const clang::tooling::CompilationDatabase& compilations,
+             const std::vector<std::string>& files, const RunSettings& settings, size_t shard,
+             size_t shards, const std::string& config, const std::string& path) {
+    seen_decls = std::make_unique<SeenDecls>(settings.header_report);
+    std::vector<size_t> indices;
+    std::vector<std::string> shard_files;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (ShardOf(files[i], shards) == shard) {
+            indices.push_back(i);
+            shard_files.push_back(files[i]);
+        }
+    }
+    llvm::json::Array results;
+    RunUnits(compilations, shard_files, settings, {}, [&](MyPrint&& report) {
+        size_t index = indices[results.size()];
+        results.push_back(llvm::json::Object{
+            {"index", index}, {"file", files[index]}, {"report", report.ToJson()}});
+    });
+    llvm::json::Object shard_file{
+        {"version", kShardFormatVersion},
+        {"config", config},
+        {"dict", DictHash()},
+        {"header_report", settings.header_report == HeaderReport::kOnce ? "once" : "each"},
+        {"shard", shard},
+        {"shards", shards},
+        {"units", files.size()},
+        {"results", std::move(results)},
+        {"headers", seen_decls->HeadersToJson()}};
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    os << llvm::json::Value(std::move(shard_file)) << '\n';
+    os.flush();
+    if (auto error = llvm::writeFileAtomically(path + ".%%%%%%%%.tmp", path, text)) {
+        llvm::errs() << path << ": " << llvm::toString(std::move(error)) << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Reads the shard files of one run into reports, by unit, and seen_decls.
+llvm::Error ReadShards(const std::vector<std::string>& paths, std::vector<MyPrint>& reports) {
+    auto fail = [](const std::string& path, const char* reason) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), "%s: %s", path.c_str(),
+                                       reason);
+    };
+    std::optional<std::string> config;
+    std::vector<bool> shards_read;
+    std::vector<bool> units_read;
+    for (const auto& path : paths) {
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer) {
+            return fail(path, buffer.getError().message().c_str());
+        }
+        auto value = llvm::json::parse((*buffer)->getBuffer());
+        if (!value) {
+            return fail(path, llvm::toString(value.takeError()).c_str());
+        }
+        auto* object = value->getAsObject();
+        if (!object || object->getInteger("version").getValueOr(0) != kShardFormatVersion) {
+            return fail(path, "not a shard file of this version of check_names");
+        }
+        auto run_config = object->getString("config");
+        auto dict = object->getString("dict");
+        auto mode = object->getString("header_report");
+        auto shard = object->getInteger("shard");
+        auto shards = object->getInteger("shards");
+        auto units = object->getInteger("units");
+        auto* results = object->getArray("results");
+        auto* headers = object->get("headers");
+        if (!run_config || !dict || !mode || !shard || !shards || !units || !results ||
+            !headers || *shards <= 0 || *shard < 0 || *shard >= *shards || *units < 0) {
+            return fail(path, "malformed shard file");
+        }
+        if (!config) {
+            config = run_config->str();
+            shards_read.resize(*shards);
+            units_read.resize(*units);
+            reports.resize(*units);
+            seen_decls = std::make_unique<SeenDecls>(*mode == "once" ? HeaderReport::kOnce
+                                                                     : HeaderReport::kEach);
+        }
+        if (*config != *run_config || shards_read.size() != static_cast<size_t>(*shards) ||
+            units_read.size() != static_cast<size_t>(*units)) {
+            return fail(path, "the shard is of a run with other options or sources");
+        }
+        if (*dict != DictHash()) {
+            return fail(path, "the shard is checked with another dictionary, pass the same -dict");
+        }
+        if (shards_read[*shard]) {
+            return fail(path, "the shard is given twice");
+        }
+        shards_read[*shard] = true;
+        for (const auto& result : *results) {
+            auto* item = result.getAsObject();
+            auto index = item ? item->getInteger("index") : llvm::None;
+            auto* report = item ? item->get("report") : nullptr;
+            if (!index || *index < 0 || *index >= *units || units_read[*index] || !report ||
+                !reports[*index].ReadJson(*report)) {
+                return fail(path, "malformed result");
+            }
+            units_read[*index] = true;
+        }
+        if (!seen_decls->ReadHeaders(*headers)) {
+            return fail(path, "malformed header section");
+        }
+    }
+    for (size_t i = 0; i < shards_read.size(); ++i) {
+        if (!shards_read[i]) {
+            return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                           "Shard %zu of %zu is missing", i, shards_read.size());
+        }
+    }
+    if (std::find(units_read.begin(), units_read.end(), false) != units_read.end()) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "The shards do not cover all the units");
+    }
+    return llvm::Error::success();
+}
+
+// check_names --merge [-dict <file>] [-format <format>] <shard files>: writes the
+// report of the run the shards are parts of, the same a single process would.
+int Merge(int argc, const char** argv) {
+    llvm::cl::list<std::string> inputs{llvm::cl::Positional, llvm::cl::OneOrMore,
+                                       llvm::cl::desc("<shard files>")};
+    llvm::cl::opt<std::string> dict{
+        "dict", llvm::cl::desc("Dictionary the shards were checked with, for the typo check")};
+    llvm::cl::opt<ReportFormat> format{
+        "format", llvm::cl::desc("Report format"), llvm::cl::init(ReportFormat::kText),
+        llvm::cl::values(
+            clEnumValN(ReportFormat::kText, "text", "human-readable text"),
+            clEnumValN(ReportFormat::kJsonLines, "jsonl", "one JSON object per line"),
+            clEnumValN(ReportFormat::kSarif, "sarif", "SARIF 2.1.0"))};
+    std::vector<const char*> args{argv[0]};
+    args.insert(args.end(), argv + 2, argv + argc);
+    if (!llvm::cl::ParseCommandLineOptions(args.size(), args.data(),
+                                           "Merges the shard files of a check_names run\n")) {
+        return 1;
+    }
     if (!dict.empty()) {
-        std::fstream file_stream;
-        file_stream.open(dict.getValue());
-        try {
-            if (file_stream.is_open()) {
-                std::string cur_word;
-                while (file_stream >> cur_word) {
-                    my_dict.push_back(cur_word);
+        if (auto error = my_dict.Load(dict)) {
+            llvm::errs() << llvm::toString(std::move(error)) << '\n';
+            return 1;
+        }
+    }
+    std::vector<MyPrint> reports;
+    if (auto error = ReadShards(inputs, reports)) {
+        llvm::errs() << llvm::toString(std::move(error)) << '\n';
+        return 1;
+    }
+    dict_index = std::make_unique<DictIndex>(my_dict, DictIndexKind::kLength);
+    TypoStage typo_stage(*dict_index);
+    ReportOutput output(format, typo_stage, llvm::outs());
+    for (auto& report : reports) {
+        output.Add(std::move(report));
+    }
+    output.Finish();
+    return 0;
+}
+
+volatile std::sig_atomic_t stop_serving = 0;
+
+// check_names -serve <socket>: stays resident and answers check requests, one at a
+// time, until a shutdown request or SIGINT/SIGTERM. A request is a JSON object
+// {"files": [paths], "unsaved": {path: contents}, "format": "text" | "jsonl" |
+// "sarif"} (only "files" is required) or {"shutdown": true}, the answer is
+// {"status": 0, "report": "..."} or {"status": 1, "error": "..."}. The dictionary,
+// its index, the typo lookups done so far and the result cache are kept between the
+// requests, and a preamble is built for each set of flags and leading system
+// includes the checked units have, up to kMaxPreambles of them.
+class CheckServer {
+public:
+    CheckServer(const clang::tooling::CompilationDatabase& compilations, RunSettings settings,
+                ReportFormat format, TypoStage& typo_stage)
+        : compilations_(compilations), settings_(settings), format_(format),
+          typo_stage_(typo_stage) {
+        settings_.preambles = &preambles_;
+    }
+
+    CheckServer(const CheckServer&) = delete;
+    CheckServer& operator=(const CheckServer&) = delete;
+
+    // The units given at the start are checked once, to build their preambles and
+    // fill the caches, and their report is dropped.
+    int Serve(const std::string& path, const std::vector<std::string>& warm_files) {
+        auto listener = ListenUnix(path);
+        if (!listener) {
+            llvm::errs() << llvm::toString(listener.takeError()) << '\n';
+            return 1;
+        }
+        struct sigaction action {};
+        action.sa_handler = [](int) { stop_serving = 1; };
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        AddPreambles(warm_files);
+        CheckFiles(compilations_, warm_files, settings_, {}, format_, typo_stage_, llvm::nulls());
+        llvm::errs() << "Serving on " << path << '\n';
+        bool stop = false;
+        while (!stop && !stop_serving) {
+            // Without SA_RESTART a signal interrupts the wait.
+            int client = accept4(*listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                llvm::errs() << llvm::toString(SocketError("accept")) << '\n';
+                break;
+            }
+            // One client at a time: a client that stalls or floods the server is cut off
+            // instead of keeping the others waiting.
+            SetSendTimeout(client, kClientTimeoutMs);
+            std::string text;
+            llvm::json::Object answer;
+            if (!ReadAll(client, text, kMaxRequestSize, kClientTimeoutMs)) {
+                answer = Failure(std::string("Cannot read the request: ") + std::strerror(errno));
+            } else if (auto request = llvm::json::parse(text)) {
+                answer = Answer(*request, stop);
+            } else {
+                answer = Failure(llvm::toString(request.takeError()));
+            }
+            std::string reply;
+            llvm::raw_string_ostream os(reply);
+            os << llvm::json::Value(std::move(answer)) << '\n';
+            os.flush();
+            WriteAll(client, reply);
+            close(client);
+            // The suggestions are kept for the next requests, up to a bound.
+            if (typo_stage_.Size() > kMaxMemoWords) {
+                typo_stage_.Clear();
+            }
+        }
+        close(*listener);
+        unlink(path.c_str());
+        for (const auto& preamble : preambles_) {
+            preamble->Remove();
+        }
+        return 0;
+    }
+
+private:
+    static constexpr size_t kMaxPreambles = 8;
+    static constexpr size_t kMaxRequestSize = 64 << 20;
+    static constexpr int kClientTimeoutMs = 10000;
+    static constexpr size_t kMaxMemoWords = 1 << 18;
+
+    static llvm::json::Object Failure(std::string message) {
+        return llvm::json::Object{{"status", 1}, {"error", std::move(message)}};
+    }
+
+    llvm::json::Object Answer(const llvm::json::Value& request, bool& stop) {
+        const auto* object = request.getAsObject();
+        if (!object) {
+            return Failure("The request is not a JSON object");
+        }
+        if (object->getBoolean("shutdown").getValueOr(false)) {
+            stop = true;
+            return llvm::json::Object{{"status", 0}, {"report", ""}};
+        }
+        std::vector<std::string> files;
+        if (const auto* list = object->getArray("files")) {
+            for (const auto& item : *list) {
+                auto file = item.getAsString();
+                if (!file) {
+                    return Failure("\"files\" must be a list of paths");
                 }
+                files.push_back(file->str());
             }
-        } catch (...) {
-            file_stream.close();
-            std::rethrow_exception(std::current_exception());
-        }
-        file_stream.close();
-    }
-
-    clang::ast_matchers::MatchFinder finder;
-    CallbackForVarDecl callback_var;
-    CallbackForFieldDecl callback_field;
-    CallbackForFunctionDecl callback_function;
-    CallbackForRecordDecl callback_record;
-    CallbackForEnumDecl callback_enum;
-    CallbackForTypeAliasDecl callback_alias;
-    CallbackForTypeDefDecl callback_decl;
-    auto matcher_var = varDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("var");
-    auto matcher_field = fieldDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("field");
-    auto matcher_function =
-        functionDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("function");
-    auto matcher_record =
-        cxxRecordDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("record");
-    auto matcher_enum = enumDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("enum");
-    auto matcher_alias = typeAliasDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("alias");
-    auto matcher_decl = typedefDecl(unless(anyOf(isImplicit(), isInstantiated()))).bind("decl");
-    finder.addMatcher(matcher_var, &callback_var);
-    finder.addMatcher(matcher_field, &callback_field);
-    finder.addMatcher(matcher_function, &callback_function);
-    finder.addMatcher(matcher_record, &callback_record);
-    finder.addMatcher(matcher_enum, &callback_enum);
-    finder.addMatcher(matcher_alias, &callback_alias);
-    finder.addMatcher(matcher_decl, &callback_decl);
-    auto factory = clang::tooling::newFrontendActionFactory(&finder);
-    tool.run(factory.get());
-    printer.Print();
+        }
+        if (files.empty()) {
+            return Failure("No files to check");
+        }
+        UnsavedFiles unsaved;
+        if (const auto* buffers = object->getObject("unsaved")) {
+            for (const auto& [file, contents] : *buffers) {
+                auto text = contents.getAsString();
+                if (!text) {
+                    return Failure("\"unsaved\" must map paths to their contents");
+                }
+                unsaved[file.str()] = text->str();
+            }
+        }
+        ReportFormat format = format_;
+        if (auto name = object->getString("format")) {
+            if (*name == "text") {
+                format = ReportFormat::kText;
+            } else if (*name == "jsonl") {
+                format = ReportFormat::kJsonLines;
+            } else if (*name == "sarif") {
+                format = ReportFormat::kSarif;
+            } else {
+                return Failure("Unknown format " + name->str());
+            }
+        }
+        if (unsaved.empty()) {
+            AddPreambles(files);
+        }
+        std::string report;
+        llvm::raw_string_ostream os(report);
+        CheckFiles(compilations_, files, settings_, unsaved, format, typo_stage_, os);
+        os.flush();
+        return llvm::json::Object{{"status", 0}, {"report", std::move(report)}};
+    }
+
+    // Builds a preamble for every unit no preamble fits yet. A unit it fails for is
+    // not tried again.
+    void AddPreambles(const std::vector<std::string>& files) {
+        if (settings_.engine == Engine::kLexer) {
+            return;
+        }
+        for (const auto& file : files) {
+            if (preambles_.size() >= kMaxPreambles) {
+                return;
+            }
+            if (no_preamble_.count(file) != 0 || FindPreamble(compilations_, settings_, file)) {
+                continue;
+            }
+            if (auto preamble = SharedPreamble::Build(compilations_, {file}, 1)) {
+                preambles_.push_back(std::move(preamble));
+            } else {
+                no_preamble_.insert(file);
+            }
+        }
+    }
+
+    const clang::tooling::CompilationDatabase& compilations_;  // NOLINT
+    RunSettings settings_;                                     // NOLINT
+    ReportFormat format_;                                      // NOLINT
+    TypoStage& typo_stage_;                                    // NOLINT
+    std::vector<std::unique_ptr<SharedPreamble>> preambles_;   // NOLINT
+    std::set<std::string> no_preamble_;                        // NOLINT
+};
+
+// check_names --compile-dict <text dictionary> <output>: writes the words and their
+// length index in the format -dict maps without parsing.
+int CompileDict(const std::string& input, const std::string& output) {
+    Dictionary words;
+    if (auto error = words.Load(input)) {
+        llvm::errs() << llvm::toString(std::move(error)) << '\n';
+        return 1;
+    }
+    if (words.Empty()) {
+        llvm::errs() << "No words in " << input << '\n';
+        return 1;
+    }
+    DictIndex index(words, DictIndexKind::kLength);
+    if (auto error = words.Compile(index.Tables(), output)) {
+        llvm::errs() << output << ": " << llvm::toString(std::move(error)) << '\n';
+        return 1;
+    }
+    // The loads with -dict check only the header and the section bounds, the whole file
+    // is verified once here.
+    Dictionary compiled;
+    if (auto error = compiled.Load(output, true)) {
+        llvm::errs() << llvm::toString(std::move(error)) << '\n';
+        return 1;
+    }
+    llvm::errs() << "Compiled " << words.Size() << " words into " << output << '\n';
     return 0;
+}
+
+int main(int argc, const char** argv) {
+    if (argc >= 2 && (llvm::StringRef(argv[1]) == "--compile-dict" ||
+                      llvm::StringRef(argv[1]) == "-compile-dict")) {
+        if (argc != 4) {
+            llvm::errs() << "Usage: " << argv[0] << " --compile-dict <words.txt> <output>\n";
+            return 1;
+        }
+        return CompileDict(argv[2], argv[3]);
+    }
+    if (argc >= 2 &&
+        (llvm::StringRef(argv[1]) == "--merge" || llvm::StringRef(argv[1]) == "-merge")) {
+        return Merge(argc, argv);
+    }
+
+    llvm::cl::OptionCategory category{"my category"};
+
+    llvm::cl::opt<std::string> dict{
+        "dict",
+        llvm::cl::desc("Dictionary of the typo check, a text file or one made by --compile-dict"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<DictIndexKind> dict_index_kind{
+        "dict-index", llvm::cl::desc("Dictionary index used by the typo check"),
+        llvm::cl::init(DictIndexKind::kLength),
+        llvm::cl::values(
+            clEnumValN(DictIndexKind::kLinear, "linear", "scan the whole dictionary"),
+            clEnumValN(DictIndexKind::kLength, "length", "length buckets, small and fast to build"),
+            clEnumValN(DictIndexKind::kDeletes, "deletes",
+                       "symmetric delete index, fastest queries, large and slow to build")),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<unsigned> jobs{
+        "j", llvm::cl::desc("Number of translation units processed concurrently (0: all cores)"),
+        llvm::cl::init(1), llvm::cl::cat{category}};
+    llvm::cl::opt<Engine> engine{
+        "engine", llvm::cl::desc("How the declarations are found"),
+        llvm::cl::init(Engine::kMatcher),
+        llvm::cl::values(clEnumValN(Engine::kMatcher, "matcher", "AST matchers over the whole AST"),
+                         clEnumValN(Engine::kVisitor, "visitor",
+                                    "one traversal that skips system headers"),
+                         clEnumValN(Engine::kLexer, "lexer",
+                                    "the lexer only, declarations recognized heuristically "
+                                    "(approximate)")),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<HeaderReport> header_report{
+        "header-report", llvm::cl::desc("Where the findings in project headers are reported"),
+        llvm::cl::init(HeaderReport::kEach),
+        llvm::cl::values(
+            clEnumValN(HeaderReport::kEach, "each", "under every unit that includes the header"),
+            clEnumValN(HeaderReport::kOnce, "once", "once, in a section after all the units")),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> cache_dir{
+        "cache-dir", llvm::cl::desc("Directory of the per-unit result cache (off if empty)"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<uint64_t> cache_size{
+        "cache-size", llvm::cl::desc("Size limit of the result cache in megabytes"),
+        llvm::cl::init(256), llvm::cl::cat{category}};
+    llvm::cl::opt<bool> cache_stats{
+        "cache-stats", llvm::cl::desc("Print result cache statistics to stderr"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<bool> shared_preamble{
+        "shared-preamble",
+        llvm::cl::desc("Precompile the system headers most units start with once and reuse them"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> cost_file{
+        "cost-file",
+        llvm::cl::desc("File keeping the time and memory of every unit between runs, for the "
+                       "scheduling (default: unit_costs in -cache-dir)"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<UnitOrder> unit_order{
+        "schedule", llvm::cl::desc("Order the units are started in"),
+        llvm::cl::init(UnitOrder::kLargestFirst),
+        llvm::cl::values(
+            clEnumValN(UnitOrder::kLargestFirst, "largest-first",
+                       "the units that took longest before (or look largest) first"),
+            clEnumValN(UnitOrder::kSources, "sources", "the order of the sources")),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<uint64_t> memory_budget{
+        "memory-budget",
+        llvm::cl::desc("Megabytes the units checked at once may take together, by their recorded "
+                       "or estimated AST size (0: no limit)"),
+        llvm::cl::init(0), llvm::cl::cat{category}};
+    llvm::cl::opt<bool> decls_only_flag{
+        "decls-only",
+        llvm::cl::desc("Skip function bodies, check types, functions, fields, enums and "
+                       "namespace-scope or static member variables only"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<ReportFormat> format{
+        "format", llvm::cl::desc("Report format"), llvm::cl::init(ReportFormat::kText),
+        llvm::cl::values(
+            clEnumValN(ReportFormat::kText, "text", "human-readable text"),
+            clEnumValN(ReportFormat::kJsonLines, "jsonl", "one JSON object per line"),
+            clEnumValN(ReportFormat::kSarif, "sarif", "SARIF 2.1.0")),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<bool> verify_dict{
+        "verify-dict",
+        llvm::cl::desc("Verify the checksum and the index of a compiled -dict before using it"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<bool> dict_stats{
+        "dict-stats", llvm::cl::desc("Print dictionary index build and query statistics to stderr"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> header_filter{
+        "header-filter",
+        llvm::cl::desc("Regular expression for the full paths of the headers to check, besides "
+                       "the system ones (default: all)"),
+        llvm::cl::cat{category}};
+    llvm::cl::list<std::string> excludes{
+        "exclude",
+        llvm::cl::desc("Regular expression for the full paths of the files not to check, may be "
+                       "given several times"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> diff{
+        "diff",
+        llvm::cl::desc("Check only the lines a unified diff adds or changes ('-' for stdin), its "
+                       "paths are relative to the current directory"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> diff_base{
+        "diff-base",
+        llvm::cl::desc("Check only the lines changed since a git revision, or in a range A..B "
+                       "ending at a clean HEAD"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> shard{
+        "shard",
+        llvm::cl::desc("Check only the part i/N (i from 0 to N - 1) of the units and write it to "
+                       "-shard-output, for --merge"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> shard_output{
+        "shard-output", llvm::cl::desc("Shard file written by -shard"), llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> serve{
+        "serve",
+        llvm::cl::desc("Stay resident and answer check requests on this Unix domain socket, the "
+                       "source files given are checked once at the start to warm the caches"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<bool> run_stats_flag{
+        "run-stats",
+        llvm::cl::desc("Print where the time of the run went and its counters to stderr (also "
+                       "--stats)"),
+        llvm::cl::cat{category}};
+    llvm::cl::opt<std::string> stats_trace{
+        "stats-trace",
+        llvm::cl::desc("Write the parse and match time of every unit as a Chrome trace (implies "
+                       "-run-stats)"),
+        llvm::cl::cat{category}};
+
+    auto expected_parser = clang::tooling::CommonOptionsParser::create(argc, argv, category);
+
+    if (!expected_parser) {
+        llvm::errs() << expected_parser.takeError() << '\n';
+        return 1;
+    }
+
+    auto& parser = *expected_parser;
+
+    if (!dict.empty()) {
+        if (auto error = my_dict.Load(dict, verify_dict)) {
+            llvm::errs() << llvm::toString(std::move(error)) << '\n';
+            return 1;
+        }
+    }
+    // --stats, the flag of LLVM statistics (empty in release builds), also turns on the
+    // statistics of the run.
+    if (run_stats_flag || llvm::AreStatisticsEnabled() || !stats_trace.empty()) {
+        run_stats.Enable();
+    }
+    dict_index = std::make_unique<DictIndex>(my_dict, dict_index_kind,
+                                             dict_stats || run_stats.Enabled());
+    decls_only = decls_only_flag;
+    size_t shard_index = 0;
+    size_t shard_count = 0;
+    if (!shard.empty()) {
+        auto [index, count] = llvm::StringRef(shard).split('/');
+        if (index.getAsInteger(10, shard_index) || count.getAsInteger(10, shard_count) ||
+            shard_index >= shard_count) {
+            llvm::errs() << "-shard must be i/N with 0 <= i < N\n";
+            return 1;
+        }
+        if (shard_output.empty()) {
+            llvm::errs() << "-shard needs -shard-output\n";
+            return 1;
+        }
+    }
+    if (!header_filter.empty() || !excludes.empty()) {
+        auto filter = PathFilter::Create(header_filter, excludes);
+        if (!filter) {
+            llvm::errs() << llvm::toString(filter.takeError()) << '\n';
+            return 1;
+        }
+        path_filter = std::move(*filter);
+    }
+    std::string filter_key = path_filter ? path_filter->Key() : "";
+    if (!diff.empty() && !diff_base.empty()) {
+        llvm::errs() << "-diff and -diff-base cannot be used together\n";
+        return 1;
+    }
+    if (!shard.empty() && !serve.empty()) {
+        llvm::errs() << "-shard is ignored with -serve\n";
+    }
+    if ((!diff.empty() || !diff_base.empty()) && !serve.empty()) {
+        llvm::errs() << "-diff and -diff-base are ignored with -serve\n";
+    } else if (!diff.empty() || !diff_base.empty()) {
+        changed_lines = std::make_unique<ChangedLines>();
+        llvm::Error error = llvm::Error::success();
+        if (!diff_base.empty()) {
+            error = changed_lines->ParseGitDiff(diff_base);
+        } else if (auto text = llvm::MemoryBuffer::getFileOrSTDIN(diff)) {
+            llvm::SmallString<256> current;
+            llvm::sys::fs::current_path(current);
+            error = changed_lines->Parse((*text)->getBuffer(), current.str().str());
+        } else {
+            error = llvm::createStringError(text.getError(), "%s: %s", diff.c_str(),
+                                            text.getError().message().c_str());
+        }
+        if (error) {
+            llvm::errs() << llvm::toString(std::move(error)) << '\n';
+            return 1;
+        }
+    }
+
+    // The units found in the cache do not register their headers, so a header section
+    // would miss their findings. The results of a diff run are partial.
+    std::unique_ptr<ResultCache> cache;
+    if (!cache_dir.empty() && header_report == HeaderReport::kOnce) {
+        llvm::errs() << "-cache-dir is ignored with -header-report=once\n";
+    } else if (!cache_dir.empty() && changed_lines) {
+        llvm::errs() << "-cache-dir is ignored with -diff and -diff-base\n";
+    } else if (!cache_dir.empty()) {
+        std::string config = "check_names " + std::to_string(kResultCacheVersion) + " " +
+                             std::to_string(static_cast<int>(engine.getValue())) + " " +
+                             std::to_string(decls_only) + " " + DictHash() + "\n" +
+                             filter_key;
+        cache = std::make_unique<ResultCache>(cache_dir, cache_size.getValue() << 20, config);
+    }
+
+    UnitCosts unit_costs;
+    std::string costs_path = cost_file;
+    if (costs_path.empty() && !cache_dir.empty()) {
+        costs_path = cache_dir + "/unit_costs";
+    }
+    if (!costs_path.empty()) {
+        unit_costs.Load(costs_path);
+    }
+    RunSettings settings{jobs,
+                         engine,
+                         header_report,
+                         cache.get(),
+                         nullptr,
+                         &unit_costs,
+                         unit_order == UnitOrder::kLargestFirst,
+                         memory_budget.getValue() << 20};
+    TypoStage typo_stage(*dict_index);
+    int status = 0;
+    if (!serve.empty()) {
+        CheckServer server(parser.getCompilations(), settings, format, typo_stage);
+        status = server.Serve(serve, parser.getSourcePathList());
+    } else {
+        // The units that cannot have a changed line or are excluded are not parsed.
+        auto files = parser.getSourcePathList();
+        if (changed_lines) {
+            files = changed_lines->Units(parser.getCompilations(), files);
+        }
+        if (path_filter) {
+            files.erase(std::remove_if(files.begin(), files.end(),
+                                       [](const std::string& file) {
+                                           return !path_filter->Accepts(RealPath(file), true);
+                                       }),
+                        files.end());
+        }
+        std::vector<std::unique_ptr<SharedPreamble>> preambles;
+        if (shared_preamble && engine != Engine::kLexer) {
+            auto preamble = SharedPreamble::Build(parser.getCompilations(), files);
+            if (preamble) {
+                preambles.push_back(std::move(preamble));
+            } else {
+                llvm::errs() << "No shared preamble, the units are parsed as usual\n";
+            }
+        }
+        settings.preambles = &preambles;
+        if (shard_count > 0) {
+            std::string config = std::to_string(static_cast<int>(engine.getValue())) + " " +
+                                 std::to_string(decls_only) + "\n" + filter_key;
+            status = RunShard(parser.getCompilations(), files, settings, shard_index, shard_count,
+                              config, shard_output);
+        } else {
+            CheckFiles(parser.getCompilations(), files, settings, {}, format, typo_stage,
+                       llvm::outs());
+        }
+        for (const auto& preamble : preambles) {
+            preamble->Remove();
+        }
+    }
+    if (dict_stats) {
+        dict_index->PrintStats();
+    }
+    if (run_stats.Enabled()) {
+        run_stats.Print(*dict_index);
+    }
+    if (!stats_trace.empty()) {
+        run_stats.WriteTrace(stats_trace);
+    }
+    if (cache) {
+        cache->Evict();
+        if (cache_stats) {
+            cache->PrintStats();
+        }
+    }
+    if (!costs_path.empty()) {
+        llvm::sys::fs::create_directories(llvm::sys::path::parent_path(costs_path));
+        unit_costs.Save(costs_path);
+    }
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <string>
+#include "unix_socket.h"
+
+// The client of check_names -serve: sends one request, prints the report and exits
+// with the status of the server.
+
+std::string Absolute(const std::string& path) {
+    llvm::SmallString<256> absolute(path);
+    llvm::sys::fs::make_absolute(absolute);
+    return absolute.str().str();
+}
+
+int main(int argc, const char** argv) {
+    llvm::cl::opt<std::string> socket_path{
+        "socket", llvm::cl::desc("Unix domain socket of check_names -serve"), llvm::cl::Required};
+    llvm::cl::list<std::string> files{llvm::cl::Positional, llvm::cl::desc("<source files>")};
+    llvm::cl::opt<std::string> stdin_file{
+        "stdin-file",
+        llvm::cl::desc("Check the unsaved contents of this file, read from the standard input")};
+    llvm::cl::opt<std::string> format{
+        "format", llvm::cl::desc("Report format: text, jsonl or sarif (default: the server's)")};
+    llvm::cl::opt<bool> shutdown_server{"shutdown", llvm::cl::desc("Stop the server")};
+    llvm::cl::ParseCommandLineOptions(argc, argv, "check_names client\n");
+
+    llvm::json::Object request;
+    if (shutdown_server) {
+        request["shutdown"] = true;
+    } else {
+        llvm::json::Array paths;
+        for (const auto& file : files) {
+            paths.push_back(Absolute(file));
+        }
+        if (!stdin_file.empty()) {
+            auto contents = llvm::MemoryBuffer::getSTDIN();
+            if (!contents) {
+                llvm::errs() << "Cannot read the standard input\n";
+                return 1;
+            }
+            std::string path = Absolute(stdin_file);
+            request["unsaved"] = llvm::json::Object{{path, (*contents)->getBuffer()}};
+            if (llvm::find(files, stdin_file) == files.end()) {
+                paths.push_back(path);
+            }
+        }
+        if (paths.empty()) {
+            llvm::errs() << "No files to check\n";
+            return 1;
+        }
+        request["files"] = std::move(paths);
+        if (!format.empty()) {
+            request["format"] = format;
+        }
+    }
+
+    auto fd = ConnectUnix(socket_path);
+    if (!fd) {
+        llvm::errs() << llvm::toString(fd.takeError()) << '\n';
+        return 1;
+    }
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    os << llvm::json::Value(std::move(request));
+    os.flush();
+    std::string reply;
+    bool sent = WriteAll(*fd, text) && shutdown(*fd, SHUT_WR) == 0;
+    if (!sent || !ReadAll(*fd, reply)) {
+        llvm::errs() << llvm::toString(SocketError(socket_path)) << '\n';
+        close(*fd);
+        return 1;
+    }
+    close(*fd);
+
+    auto answer = llvm::json::parse(reply);
+    if (!answer) {
+        llvm::errs() << "Bad answer: " << llvm::toString(answer.takeError()) << '\n';
+        return 1;
+    }
+    const auto* object = answer->getAsObject();
+    if (!object) {
+        llvm::errs() << "Bad answer: not a JSON object\n";
+        return 1;
+    }
+    if (auto error = object->getString("error")) {
+        llvm::errs() << *error << '\n';
+    }
+    if (auto report = object->getString("report")) {
+        llvm::outs() << *report;
+    }
+    return static_cast<int>(object->getInteger("status").getValueOr(1));
+}
@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# Compares two benchmark_results.txt files written by run_benchmarks.sh: for every
+# measurement present in both, prints each numeric metric of the baseline and the
+# current run and their ratio (current / baseline).
+
+set -e
+
+BASELINE=$1
+CURRENT=$2
+
+awk '
+function metrics(line, name, out,    fields, n, i, pair) {
+    n = split(line, fields, " ")
+    for (i = 2; i <= n; ++i) {
+        if (split(fields[i], pair, "=") == 2 && pair[2] ~ /^[0-9.]+$/) {
+            out[name SUBSEP pair[1]] = pair[2]
+        }
+    }
+}
+FNR == NR {
+    metrics($0, $1, baseline)
+    next
+}
+{
+    delete current
+    metrics($0, $1, current)
+    for (key in current) {
+        if (!(key in baseline)) {
+            continue
+        }
+        split(key, parts, SUBSEP)
+        ratio = baseline[key] == 0 ? "-" : sprintf("%.2f", current[key] / baseline[key])
+        printf "%s %s baseline=%s current=%s ratio=%s\n", parts[1], parts[2], baseline[key],
+               current[key], ratio
+    }
+}
+' "$BASELINE" "$CURRENT"
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include "dictionary.h"
+#include "lev_batch.h"
+#include "levenshtein.h"
+
+// Nearest dictionary word for an identifier word. A distance above
+// kMaxTypoDistance means that nothing close enough was found.
+struct Suggestion {
+    int distance = kMaxTypoDistance + 1;
+    size_t index = 0;
+};
+
+// The linear scan keeps the first dictionary word with the smallest distance,
+// every index reproduces that order.
+inline bool IsBetter(const Suggestion& lhs, const Suggestion& rhs) {
+    return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.index < rhs.index);
+}
+
+enum class DictIndexKind { kLinear, kLength, kDeletes };
+
+inline std::string Str(DictIndexKind kind) {
+    switch (kind) {
+        case DictIndexKind::kLinear:
+            return "linear";
+        case DictIndexKind::kLength:
+            return "length";
+        case DictIndexKind::kDeletes:
+            return "deletes";
+        default:
+            throw std::runtime_error{"Bad dictionary index"};
+    }
+}
+
+// One bit per character class present in the word. Every character present in
+// one word and missing from the other costs at least one edit, so the popcount of
+// the difference is a lower bound on the distance.
+inline uint32_t CharSignature(std::string_view word) {
+    uint32_t signature = 0;
+    for (char c : word) {
+        auto code = static_cast<unsigned char>(c);
+        signature |= uint32_t{1} << ((code >= 'a' && code <= 'z') ? code - 'a' : 26 + code % 6);
+    }
+    return signature;
+}
+
+inline int SignatureDistance(uint32_t lhs, uint32_t rhs) {
+    return std::max(__builtin_popcount(lhs & ~rhs), __builtin_popcount(rhs & ~lhs));
+}
+
+// Hashes of every string obtained from word by deleting at most budget characters.
+// If two words are within distance k of each other, they share such a string for
+// budget k, so equal hashes give a complete candidate set (collisions only add
+// candidates, which are verified anyway).
+inline void CollectDeletes(std::string& word, size_t start, int budget,
+                           std::vector<uint32_t>& hashes) {
+    hashes.push_back(static_cast<uint32_t>(llvm::xxHash64(word)));
+    if (budget == 0) {
+        return;
+    }
+    for (size_t pos = start; pos < word.size(); ++pos) {
+        char removed = word[pos];
+        word.erase(pos, 1);
+        CollectDeletes(word, pos, budget - 1, hashes);
+        word.insert(word.begin() + pos, removed);
+    }
+}
+
+inline void CollectDeletes(std::string_view word, std::vector<uint32_t>& hashes) {
+    std::string buffer(word);
+    hashes.clear();
+    CollectDeletes(buffer, 0, kMaxTypoDistance, hashes);
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+}
+
+// Nearest-word search over a dictionary, built once after the dictionary is loaded.
+//  * kLinear: the plain scan, no extra memory.
+//  * kLength: words bucketed by length with character signatures plus the word
+//    indices sorted by word for exact matches; only buckets within
+//    kMaxTypoDistance of the query length are scanned, nearest first. Small and
+//    cheap to build, a compiled dictionary stores it ready to use. The words of a
+//    bucket are scored in batches by the kernel, the widest one the CPU runs by
+//    default.
+//  * kDeletes: symmetric delete index, sorted (hash, word) pairs for every
+//    deletion of up to kMaxTypoDistance characters. Queries only verify the
+//    words sharing a deletion with the query, at the price of roughly a hundred
+//    entries per word and a slow build.
+class DictIndex {
+public:
+    DictIndex(const Dictionary& words, DictIndexKind kind, bool collect_stats = false,
+              LevKernel kernel = BestLevKernel())
+        : words_(&words), kind_(kind), stats_(collect_stats), kernel_(kernel) {
+        auto start = std::chrono::steady_clock::now();
+        if (kind_ == DictIndexKind::kLength) {
+            BuildByLength();
+        } else if (kind_ == DictIndexKind::kDeletes) {
+            BuildDeletes();
+        }
+        build_time_ = std::chrono::steady_clock::now() - start;
+    }
+
+    DictIndexKind Kind() const {
+        return kind_;
+    }
+
+    // The length index, empty unless the kind is kLength.
+    const LengthTables& Tables() const {
+        return tables_;
+    }
+
+    Suggestion Find(const LevPattern& pattern) const {
+        uint64_t comparisons = 0;
+        if (!stats_) {
+            return FindImpl(pattern, comparisons);
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto result = FindImpl(pattern, comparisons);
+        auto spent = std::chrono::steady_clock::now() - start;
+        queries_.fetch_add(1, std::memory_order_relaxed);
+        comparisons_.fetch_add(comparisons, std::memory_order_relaxed);
+        query_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count(),
+                            std::memory_order_relaxed);
+        return result;
+    }
+
+    // The counters below are only kept with collect_stats.
+    uint64_t Queries() const {
+        return queries_.load();
+    }
+
+    // Distance computations against dictionary words.
+    uint64_t Comparisons() const {
+        return comparisons_.load();
+    }
+
+    uint64_t QueryTime() const {
+        return query_ns_.load();
+    }
+
+    // Approximate heap footprint of the index itself, the words are not included.
+    size_t MemoryUsage() const {
+        // The tables of a compiled dictionary are mapped from the file and not counted.
+        size_t bytes = deletes_.capacity() * sizeof(deletes_[0]);
+        bytes += entries_.capacity() * sizeof(entries_[0]);
+        bytes += starts_.capacity() * sizeof(starts_[0]);
+        bytes += sorted_.capacity() * sizeof(sorted_[0]);
+        return bytes;
+    }
+
+    void PrintStats(llvm::raw_ostream& os = llvm::errs()) const {
+        auto queries = queries_.load();
+        os << "Dictionary index: " << Str(kind_) << ", " << words_->Size() << " words\n";
+        if (kind_ == DictIndexKind::kLength) {
+            os << "Distance kernel: " << Str(kernel_) << "\n";
+        }
+        os << "Build time: "
+           << std::chrono::duration_cast<std::chrono::microseconds>(build_time_).count()
+           << " us\n";
+        os << "Memory: " << MemoryUsage() << " bytes\n";
+        os << "Queries: " << queries << ", average latency: "
+           << (queries == 0 ? 0 : query_ns_.load() / queries) << " ns\n";
+        os << "Comparisons: " << comparisons_.load() << "\n";
+    }
+
+private:
+    Suggestion FindImpl(const LevPattern& pattern, uint64_t& comparisons) const {
+        switch (kind_) {
+            case DictIndexKind::kLength:
+                return FindByLength(pattern, comparisons);
+            case DictIndexKind::kDeletes:
+                return FindByDeletes(pattern, comparisons);
+            default:
+                return FindLinear(pattern, comparisons);
+        }
+    }
+
+    void Consider(const LevPattern& pattern, size_t index, Suggestion& best,
+                  uint64_t& comparisons) const {
+        ++comparisons;
+        int distance = pattern.Distance((*words_)[index], best.distance);
+        Suggestion candidate{distance, index};
+        if (distance <= kMaxTypoDistance && IsBetter(candidate, best)) {
+            best = candidate;
+        }
+    }
+
+    Suggestion FindLinear(const LevPattern& pattern, uint64_t& comparisons) const {
+        Suggestion best;
+        for (size_t i = 0; i < words_->Size() && best.distance > 0; ++i) {
+            ++comparisons;
+            int distance = pattern.Distance((*words_)[i], best.distance - 1);
+            if (distance < best.distance) {
+                best = {distance, i};
+            }
+        }
+        return best;
+    }
+
+    void BuildByLength() {
+        if (words_->Tables()) {
+            tables_ = *words_->Tables();
+            return;
+        }
+        size_t max_length = 0;
+        for (size_t i = 0; i < words_->Size(); ++i) {
+            max_length = std::max(max_length, (*words_)[i].size());
+        }
+        // Counting sort by length keeps the dictionary order inside a bucket.
+        starts_.assign(max_length + 2, 0);
+        for (size_t i = 0; i < words_->Size(); ++i) {
+            ++starts_[(*words_)[i].size() + 1];
+        }
+        for (size_t len = 1; len < starts_.size(); ++len) {
+            starts_[len] += starts_[len - 1];
+        }
+        entries_.resize(words_->Size());
+        std::vector<uint32_t> next(starts_.begin(), starts_.end() - 1);
+        for (size_t i = 0; i < words_->Size(); ++i) {
+            auto word = (*words_)[i];
+            entries_[next[word.size()]++] = {CharSignature(word), static_cast<uint32_t>(i)};
+        }
+        sorted_.resize(words_->Size());
+        for (size_t i = 0; i < sorted_.size(); ++i) {
+            sorted_[i] = static_cast<uint32_t>(i);
+        }
+        std::stable_sort(sorted_.begin(), sorted_.end(), [&](uint32_t lhs, uint32_t rhs) {
+            return (*words_)[lhs] < (*words_)[rhs];
+        });
+        tables_ = {entries_, starts_, sorted_};
+    }
+
+    Suggestion FindByLength(const LevPattern& pattern, uint64_t& comparisons) const {
+        // The first index among equal words, as the linear scan would find.
+        std::string_view query = pattern.Word();
+        auto it = std::lower_bound(
+            tables_.sorted.begin(), tables_.sorted.end(), query,
+            [&](uint32_t index, std::string_view word) { return (*words_)[index] < word; });
+        if (it != tables_.sorted.end() && (*words_)[*it] == query) {
+            return {0, *it};
+        }
+        Suggestion best;
+        int len = static_cast<int>(pattern.Word().size());
+        uint32_t signature = CharSignature(pattern.Word());
+        LevBatch batch(pattern, kernel_);
+        std::array<std::string_view, kMaxBatchWords> words;
+        std::array<uint32_t, kMaxBatchWords> indices;
+        std::array<int, kMaxBatchWords> distances;
+        size_t count = 0;
+        // A batch is scored against the best distance found before it. IsBetter orders
+        // by distance and then by index, so the result is that of one word at a time.
+        auto flush = [&] {
+            batch.Score(words.data(), count, best.distance, distances.data());
+            comparisons += count;
+            for (size_t k = 0; k < count; ++k) {
+                Suggestion candidate{distances[k], indices[k]};
+                if (candidate.distance <= kMaxTypoDistance && IsBetter(candidate, best)) {
+                    best = candidate;
+                }
+            }
+            count = 0;
+        };
+        // The distance is at least the length difference, so nearer buckets go first.
+        for (int diff = 1; diff <= 2 * kMaxTypoDistance + 1; ++diff) {
+            int offset = (diff % 2 == 0) ? diff / 2 : -(diff / 2);
+            if (std::abs(offset) > best.distance) {
+                break;
+            }
+            int bucket = len + offset;
+            if (bucket < 0 || bucket + 1 >= static_cast<int>(tables_.starts.size())) {
+                continue;
+            }
+            for (auto i = tables_.starts[bucket]; i < tables_.starts[bucket + 1]; ++i) {
+                const auto& entry = tables_.entries[i];
+                if (SignatureDistance(signature, entry.signature) <= best.distance) {
+                    words[count] = (*words_)[entry.index];
+                    indices[count] = entry.index;
+                    if (++count == batch.Capacity()) {
+                        flush();
+                    }
+                }
+            }
+            flush();
+        }
+        return best;
+    }
+
+    void BuildDeletes() {
+        std::vector<uint32_t> hashes;
+        for (size_t i = 0; i < words_->Size(); ++i) {
+            CollectDeletes((*words_)[i], hashes);
+            for (auto hash : hashes) {
+                deletes_.emplace_back(hash, static_cast<uint32_t>(i));
+            }
+        }
+        std::sort(deletes_.begin(), deletes_.end());
+        deletes_.shrink_to_fit();
+    }
+
+    Suggestion FindByDeletes(const LevPattern& pattern, uint64_t& comparisons) const {
+        std::vector<uint32_t> hashes;
+        CollectDeletes(pattern.Word(), hashes);
+        std::vector<uint32_t> candidates;
+        for (auto hash : hashes) {
+            auto it = std::lower_bound(deletes_.begin(), deletes_.end(), std::make_pair(hash, 0u));
+            for (; it != deletes_.end() && it->first == hash; ++it) {
+                candidates.push_back(it->second);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        Suggestion best;
+        for (auto index : candidates) {
+            Consider(pattern, index, best, comparisons);
+        }
+        return best;
+    }
+
+    const Dictionary* words_;
+    DictIndexKind kind_;
+    bool stats_;
+    LevKernel kernel_;
+    std::chrono::steady_clock::duration build_time_;
+    LengthTables tables_;
+    std::vector<LengthEntry> entries_;
+    std::vector<uint32_t> starts_;
+    std::vector<uint32_t> sorted_;
+    std::vector<std::pair<uint32_t, uint32_t>> deletes_;
+    mutable std::atomic<uint64_t> queries_ = 0;
+    mutable std::atomic<uint64_t> query_ns_ = 0;
+    mutable std::atomic<uint64_t> comparisons_ = 0;
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/xxhash.h>
+
+// Bump whenever the layout of a compiled dictionary changes.
+constexpr uint32_t kDictFormatVersion = 1;
+constexpr char kDictMagic[8] = {'C', 'N', 'D', 'I', 'C', 'T', '\0', '\0'};
+
+// A word of the length index of DictIndex: the character signature and the word.
+struct LengthEntry {
+    uint32_t signature;
+    uint32_t index;
+};
+
+// The length index of DictIndex. The bucket of the words of length l is
+// entries[starts[l], starts[l + 1]), in dictionary order; sorted holds the word
+// indices ordered by word and then by index, for exact matches.
+struct LengthTables {
+    llvm::ArrayRef<LengthEntry> entries;
+    llvm::ArrayRef<uint32_t> starts;
+    llvm::ArrayRef<uint32_t> sorted;
+};
+
+// The header of a compiled dictionary. It is followed by the sections, each one
+// starting at a multiple of 8 bytes: the word offsets (words + 1 of them), the
+// length entries, the bucket starts, the sorted indices and the words themselves.
+// The checksum covers everything after the header. Integers are stored in the
+// byte order of the machine that compiled the dictionary.
+struct DictHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t words;
+    uint32_t buckets;
+    uint32_t pool_size;
+    uint64_t checksum;
+};
+
+// The dictionary words. A text dictionary (words separated by whitespace) is read
+// into one buffer, a compiled one (see Compile) is mapped into memory and used as
+// is: only the header and the bounds of the sections are checked, nothing is read
+// past them. The checksum and the index are verified on request.
+class Dictionary {
+public:
+    Dictionary() = default;
+    Dictionary(const Dictionary&) = delete;
+    Dictionary& operator=(const Dictionary&) = delete;
+
+    // A missing file gives an empty dictionary, a broken compiled one an error. With
+    // verify, the checksum and the index of a compiled one are checked too, which
+    // reads the whole file.
+    llvm::Error Load(const std::string& path, bool verify = false) {
+        auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+        if (!buffer) {
+            return llvm::Error::success();
+        }
+        if (!(*buffer)->getBuffer().startswith(llvm::StringRef(kDictMagic, sizeof(kDictMagic)))) {
+            return Read((*buffer)->getBuffer());
+        }
+        buffer_ = std::move(*buffer);
+        return Map(path, verify);
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    std::string_view operator[](size_t index) const {
+        return {pool_ + offsets_[index], offsets_[index + 1] - offsets_[index]};
+    }
+
+    // The length index of a compiled dictionary, nullopt for a text one.
+    const std::optional<LengthTables>& Tables() const {
+        return tables_;
+    }
+
+    // Writes the words and their length index as a compiled dictionary.
+    llvm::Error Compile(const LengthTables& tables, const std::string& path) const {
+        std::string body;
+        Append(body, llvm::ArrayRef<uint32_t>(offsets_, size_ + 1));
+        Append(body, tables.entries);
+        Append(body, tables.starts);
+        Append(body, tables.sorted);
+        body.append(pool_, offsets_[size_]);
+        DictHeader header{};
+        std::memcpy(header.magic, kDictMagic, sizeof(kDictMagic));
+        header.version = kDictFormatVersion;
+        header.words = static_cast<uint32_t>(size_);
+        header.buckets = static_cast<uint32_t>(tables.starts.size());
+        header.pool_size = offsets_[size_];
+        header.checksum = llvm::xxHash64(body);
+        std::string text(reinterpret_cast<const char*>(&header), sizeof(header));
+        text += body;
+        return llvm::writeFileAtomically(path + ".%%%%%%%%.tmp", path, text);
+    }
+
+    // Reads the words of a text dictionary, separated by whitespace.
+    llvm::Error Read(llvm::StringRef text) {
+        text_pool_.reserve(text.size());
+        text_offsets_.push_back(0);
+        size_t pos = 0;
+        while (pos < text.size()) {
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+                ++pos;
+            }
+            size_t start = pos;
+            while (pos < text.size() && !std::isspace(static_cast<unsigned char>(text[pos]))) {
+                ++pos;
+            }
+            if (pos == start) {
+                break;
+            }
+            text_pool_.append(text.data() + start, pos - start);
+            if (text_pool_.size() > std::numeric_limits<uint32_t>::max()) {
+                return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                               "The dictionary is larger than 4 GB");
+            }
+            text_offsets_.push_back(static_cast<uint32_t>(text_pool_.size()));
+        }
+        pool_ = text_pool_.data();
+        offsets_ = text_offsets_.data();
+        size_ = text_offsets_.size() - 1;
+        return llvm::Error::success();
+    }
+
+private:
+    llvm::Error Map(const std::string& path, bool verify) {
+        auto fail = [&](const char* reason) {
+            buffer_.reset();
+            return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                           "%s: %s, compile the dictionary again", path.c_str(),
+                                           reason);
+        };
+        llvm::StringRef data = buffer_->getBuffer();
+        DictHeader header;
+        if (data.size() < sizeof(header)) {
+            return fail("truncated header");
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.version != kDictFormatVersion) {
+            return fail("unsupported version");
+        }
+        if (reinterpret_cast<uintptr_t>(data.data()) % alignof(uint64_t) != 0) {
+            return fail("misaligned buffer");
+        }
+        size_t pos = sizeof(header);
+        auto offsets = Section<uint32_t>(data, pos, size_t{header.words} + 1);
+        auto entries = Section<LengthEntry>(data, pos, header.words);
+        auto starts = Section<uint32_t>(data, pos, header.buckets);
+        auto sorted = Section<uint32_t>(data, pos, header.words);
+        if (pos + header.pool_size != data.size()) {
+            return fail("wrong size");
+        }
+        if (verify && llvm::xxHash64(data.drop_front(sizeof(header))) != header.checksum) {
+            return fail("checksum mismatch");
+        }
+        if (verify && !IsConsistent(offsets, header.pool_size, entries, starts, sorted)) {
+            return fail("corrupt index");
+        }
+        pool_ = data.data() + pos;
+        offsets_ = offsets.data();
+        size_ = header.words;
+        tables_ = LengthTables{entries, starts, sorted};
+        return llvm::Error::success();
+    }
+
+    // Whether every word and every index entry of a compiled dictionary lies within
+    // it, as operator[] and DictIndex take for granted: the word offsets do not
+    // decrease and end within the pool, the bucket starts do not decrease and end
+    // within the entries, an entry of bucket l is a word of length l and the indices
+    // are those of words.
+    static bool IsConsistent(llvm::ArrayRef<uint32_t> offsets, uint32_t pool_size,
+                             llvm::ArrayRef<LengthEntry> entries, llvm::ArrayRef<uint32_t> starts,
+                             llvm::ArrayRef<uint32_t> sorted) {
+        size_t words = offsets.size() - 1;
+        for (size_t i = 1; i < offsets.size(); ++i) {
+            if (offsets[i] < offsets[i - 1]) {
+                return false;
+            }
+        }
+        if (offsets.back() > pool_size) {
+            return false;
+        }
+        for (size_t len = 0; len < starts.size(); ++len) {
+            if (starts[len] > entries.size() || (len > 0 && starts[len] < starts[len - 1])) {
+                return false;
+            }
+            size_t end = len + 1 < starts.size() ? starts[len + 1] : starts[len];
+            for (size_t i = starts[len]; i < end && i < entries.size(); ++i) {
+                size_t index = entries[i].index;
+                if (index >= words || offsets[index + 1] - offsets[index] != len) {
+                    return false;
+                }
+            }
+        }
+        for (const auto& entry : entries) {
+            if (entry.index >= words) {
+                return false;
+            }
+        }
+        for (auto index : sorted) {
+            if (index >= words) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The next section of count items at pos, empty if it does not fit into data.
+    template <class T>
+    static llvm::ArrayRef<T> Section(llvm::StringRef data, size_t& pos, size_t count) {
+        pos = (pos + 7) & ~size_t{7};
+        if (pos > data.size() || count > (data.size() - pos) / sizeof(T)) {
+            pos = data.size() + 1;
+            return {};
+        }
+        llvm::ArrayRef<T> section(reinterpret_cast<const T*>(data.data() + pos), count);
+        pos += count * sizeof(T);
+        return section;
+    }
+
+    template <class T>
+    static void Append(std::string& body, llvm::ArrayRef<T> section) {
+        body.resize((body.size() + 7) & ~size_t{7}, '\0');
+        body.append(reinterpret_cast<const char*>(section.data()), section.size() * sizeof(T));
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer_;
+    std::string text_pool_;
+    std::vector<uint32_t> text_offsets_;
+    const char* pool_ = "";
+    const uint32_t* offsets_ = kNoOffsets;
+    size_t size_ = 0;
+    std::optional<LengthTables> tables_;
+
+    static constexpr uint32_t kNoOffsets[1] = {0};
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "levenshtein.h"
+
+// Batches of dictionary words are scored against one identifier word together,
+// one word per lane: the pattern bits of Myers' algorithm fit in 16 bits for an
+// identifier word of up to kMaxBatchQuery characters, so a 128-bit register holds
+// 8 words, a 256-bit one 16 and a 512-bit one 32. The words of a batch have the
+// same length and are stored by column, character j of word k at
+// columns[j * kMaxBatchWords + k].
+constexpr size_t kMaxBatchWords = 32;
+constexpr size_t kMaxBatchQuery = 16;
+// The dictionary words compared with a short enough identifier word are at most
+// this long, see DictIndex::FindByLength.
+constexpr size_t kMaxBatchLength = kMaxBatchQuery + kMaxTypoDistance;
+
+// The kernels, by instruction set: SSE4.2, AVX2 and AVX-512BW. The scalar one
+// runs LevPattern on every word of the batch.
+enum class LevKernel { kScalar, kSse, kAvx, kAvxWide };
+
+inline std::string Str(LevKernel kernel) {
+    switch (kernel) {
+        case LevKernel::kScalar:
+            return "scalar";
+        case LevKernel::kSse:
+            return "sse4.2";
+        case LevKernel::kAvx:
+            return "avx2";
+        case LevKernel::kAvxWide:
+            return "avx512";
+        default:
+            throw std::runtime_error{"Bad kernel"};
+    }
+}
+
+inline size_t Lanes(LevKernel kernel) {
+    switch (kernel) {
+        case LevKernel::kSse:
+            return 8;
+        case LevKernel::kAvx:
+            return 16;
+        default:
+            return kMaxBatchWords;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Each kernel runs the loop of LevPattern::Distance on every lane and stores the
+// distances of the first Lanes(kernel) words into scores. The pattern bitmask of a
+// column is built by comparing the column with every character of the query.
+
+__attribute__((target("sse4.2"))) inline void ScoreColumnsSse(const uint8_t* query, int n,
+                                                              const uint8_t* columns, int m,
+                                                              int16_t* scores) {
+    __m128i ones = _mm_set1_epi16(-1);
+    __m128i one = _mm_set1_epi16(1);
+    __m128i last = _mm_set1_epi16(static_cast<int16_t>(1u << (n - 1)));
+    __m128i pv = ones;
+    __m128i mv = _mm_setzero_si128();
+    __m128i score = _mm_set1_epi16(static_cast<int16_t>(n));
+    for (int j = 0; j < m; ++j) {
+        __m128i chars = _mm_cvtepu8_epi16(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(columns + j * kMaxBatchWords)));
+        __m128i eq = _mm_setzero_si128();
+        for (int i = 0; i < n; ++i) {
+            __m128i hit = _mm_cmpeq_epi16(chars, _mm_set1_epi16(query[i]));
+            eq = _mm_or_si128(
+                eq, _mm_and_si128(hit, _mm_set1_epi16(static_cast<int16_t>(1u << i))));
+        }
+        __m128i xv = _mm_or_si128(eq, mv);
+        __m128i xh = _mm_or_si128(
+            _mm_xor_si128(_mm_add_epi16(_mm_and_si128(eq, pv), pv), pv), eq);
+        __m128i ph = _mm_or_si128(mv, _mm_andnot_si128(_mm_or_si128(xh, pv), ones));
+        __m128i mh = _mm_and_si128(pv, xh);
+        score = _mm_sub_epi16(score, _mm_cmpeq_epi16(_mm_and_si128(ph, last), last));
+        score = _mm_add_epi16(score, _mm_cmpeq_epi16(_mm_and_si128(mh, last), last));
+        ph = _mm_or_si128(_mm_slli_epi16(ph, 1), one);
+        mh = _mm_slli_epi16(mh, 1);
+        pv = _mm_or_si128(mh, _mm_andnot_si128(_mm_or_si128(xv, ph), ones));
+        mv = _mm_and_si128(ph, xv);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(scores), score);
+}
+
+__attribute__((target("avx2"))) inline void ScoreColumnsAvx(const uint8_t* query, int n,
+                                                            const uint8_t* columns, int m,
+                                                            int16_t* scores) {
+    __m256i ones = _mm256_set1_epi16(-1);
+    __m256i one = _mm256_set1_epi16(1);
+    __m256i last = _mm256_set1_epi16(static_cast<int16_t>(1u << (n - 1)));
+    __m256i pv = ones;
+    __m256i mv = _mm256_setzero_si256();
+    __m256i score = _mm256_set1_epi16(static_cast<int16_t>(n));
+    for (int j = 0; j < m; ++j) {
+        __m256i chars = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + j * kMaxBatchWords)));
+        __m256i eq = _mm256_setzero_si256();
+        for (int i = 0; i < n; ++i) {
+            __m256i hit = _mm256_cmpeq_epi16(chars, _mm256_set1_epi16(query[i]));
+            eq = _mm256_or_si256(
+                eq, _mm256_and_si256(hit, _mm256_set1_epi16(static_cast<int16_t>(1u << i))));
+        }
+        __m256i xv = _mm256_or_si256(eq, mv);
+        __m256i xh = _mm256_or_si256(
+            _mm256_xor_si256(_mm256_add_epi16(_mm256_and_si256(eq, pv), pv), pv), eq);
+        __m256i ph = _mm256_or_si256(mv, _mm256_andnot_si256(_mm256_or_si256(xh, pv), ones));
+        __m256i mh = _mm256_and_si256(pv, xh);
+        score = _mm256_sub_epi16(score, _mm256_cmpeq_epi16(_mm256_and_si256(ph, last), last));
+        score = _mm256_add_epi16(score, _mm256_cmpeq_epi16(_mm256_and_si256(mh, last), last));
+        ph = _mm256_or_si256(_mm256_slli_epi16(ph, 1), one);
+        mh = _mm256_slli_epi16(mh, 1);
+        pv = _mm256_or_si256(mh, _mm256_andnot_si256(_mm256_or_si256(xv, ph), ones));
+        mv = _mm256_and_si256(ph, xv);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(scores), score);
+}
+
+__attribute__((target("avx512bw"))) inline void ScoreColumnsAvxWide(const uint8_t* query, int n,
+                                                                    const uint8_t* columns, int m,
+                                                                    int16_t* scores) {
+    __m512i ones = _mm512_set1_epi16(-1);
+    __m512i one = _mm512_set1_epi16(1);
+    __m512i last = _mm512_set1_epi16(static_cast<int16_t>(1u << (n - 1)));
+    __m512i pv = ones;
+    __m512i mv = _mm512_setzero_si512();
+    __m512i score = _mm512_set1_epi16(static_cast<int16_t>(n));
+    for (int j = 0; j < m; ++j) {
+        __m512i chars = _mm512_cvtepu8_epi16(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + j * kMaxBatchWords)));
+        __m512i eq = _mm512_setzero_si512();
+        for (int i = 0; i < n; ++i) {
+            __mmask32 hit = _mm512_cmpeq_epi16_mask(chars, _mm512_set1_epi16(query[i]));
+            eq = _mm512_mask_mov_epi16(
+                eq, hit, _mm512_or_si512(eq, _mm512_set1_epi16(static_cast<int16_t>(1u << i))));
+        }
+        __m512i xv = _mm512_or_si512(eq, mv);
+        __m512i xh = _mm512_or_si512(
+            _mm512_xor_si512(_mm512_add_epi16(_mm512_and_si512(eq, pv), pv), pv), eq);
+        __m512i ph = _mm512_or_si512(mv, _mm512_xor_si512(_mm512_or_si512(xh, pv), ones));
+        __m512i mh = _mm512_and_si512(pv, xh);
+        score = _mm512_mask_add_epi16(score, _mm512_test_epi16_mask(ph, last), score, one);
+        score = _mm512_mask_sub_epi16(score, _mm512_test_epi16_mask(mh, last), score, one);
+        ph = _mm512_or_si512(_mm512_slli_epi16(ph, 1), one);
+        mh = _mm512_slli_epi16(mh, 1);
+        pv = _mm512_or_si512(mh, _mm512_xor_si512(_mm512_or_si512(xv, ph), ones));
+        mv = _mm512_and_si512(ph, xv);
+    }
+    _mm512_storeu_si512(scores, score);
+}
+
+inline bool Supported(LevKernel kernel) {
+    switch (kernel) {
+        case LevKernel::kSse:
+            return __builtin_cpu_supports("sse4.2");
+        case LevKernel::kAvx:
+            return __builtin_cpu_supports("avx2");
+        case LevKernel::kAvxWide:
+            return __builtin_cpu_supports("avx512bw");
+        default:
+            return true;
+    }
+}
+
+#else
+
+inline bool Supported(LevKernel kernel) {
+    return kernel == LevKernel::kScalar;
+}
+
+#endif
+
+// The widest kernel the CPU runs, detected once.
+inline LevKernel BestLevKernel() {
+    static LevKernel best = [] {
+        for (auto kernel : {LevKernel::kAvxWide, LevKernel::kAvx, LevKernel::kSse}) {
+            if (Supported(kernel)) {
+                return kernel;
+            }
+        }
+        return LevKernel::kScalar;
+    }();
+    return best;
+}
+
+// The distances of one identifier word to batches of dictionary words. Identifier
+// words that are empty or longer than kMaxBatchQuery characters, and kernels the
+// CPU does not run, fall back to the scalar kernel.
+class LevBatch {
+public:
+    LevBatch(const LevPattern& pattern, LevKernel kernel)
+        : pattern_(&pattern), kernel_(kernel) {
+        size_t size = pattern.Word().size();
+        if (size == 0 || size > kMaxBatchQuery || !Supported(kernel)) {
+            kernel_ = LevKernel::kScalar;
+        }
+    }
+
+    // The number of words worth collecting before a call to Score.
+    size_t Capacity() const {
+        return Lanes(kernel_);
+    }
+
+    // Scores count <= Capacity() words of the same length, distances[k] is the
+    // distance to words[k] if it does not exceed bound and bound + 1 otherwise, as
+    // LevPattern::Distance returns it.
+    void Score(const std::string_view* words, size_t count, int bound, int* distances) const {
+        if (count == 0) {
+            return;
+        }
+        size_t length = words[0].size();
+        if (kernel_ == LevKernel::kScalar || length > kMaxBatchLength) {
+            for (size_t k = 0; k < count; ++k) {
+                distances[k] = pattern_->Distance(words[k], bound);
+            }
+            return;
+        }
+        // The lanes past count compare zeros, which no identifier contains.
+        std::array<uint8_t, kMaxBatchLength * kMaxBatchWords> columns;
+        for (size_t j = 0; j < length; ++j) {
+            auto* column = columns.data() + j * kMaxBatchWords;
+            for (size_t k = 0; k < count; ++k) {
+                column[k] = static_cast<uint8_t>(words[k][j]);
+            }
+            std::fill(column + count, column + Capacity(), 0);
+        }
+        Run(columns.data(), static_cast<int>(length), count, bound, distances);
+    }
+
+private:
+    void Run(const uint8_t* columns, int m, size_t count, int bound, int* distances) const {
+        const auto& word = pattern_->Word();
+        auto* query = reinterpret_cast<const uint8_t*>(word.data());
+        int n = static_cast<int>(word.size());
+        std::array<int16_t, kMaxBatchWords> scores;
+#if defined(__x86_64__) || defined(__i386__)
+        if (kernel_ == LevKernel::kSse) {
+            ScoreColumnsSse(query, n, columns, m, scores.data());
+        } else if (kernel_ == LevKernel::kAvx) {
+            ScoreColumnsAvx(query, n, columns, m, scores.data());
+        } else {
+            ScoreColumnsAvxWide(query, n, columns, m, scores.data());
+        }
+#endif
+        for (size_t k = 0; k < count; ++k) {
+            distances[k] = std::min<int>(scores[k], bound + 1);
+        }
+    }
+
+    const LevPattern* pattern_;  // NOLINT
+    LevKernel kernel_;           // NOLINT
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include <llvm/ADT/SmallVector.h>
+
+// Only distances below this bound are interesting for the typo check.
+constexpr int kMaxTypoDistance = 3;
+
+inline char ToLower(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+// Ukkonen's banded dynamic programming: only the cells with |i - j| <= bound are
+// computed, everything outside the band is clamped to bound + 1. Characters are
+// compared as is, case folding is done by LevPattern.
+// Returns the distance if it does not exceed bound and bound + 1 otherwise.
+inline int BandedLevDistance(std::string_view wrong, std::string_view good, int bound) {
+    int n = static_cast<int>(wrong.size());
+    int m = static_cast<int>(good.size());
+    if (std::abs(n - m) > bound) {
+        return bound + 1;
+    }
+    int width = 2 * bound + 1;
+    llvm::SmallVector<int, 2 * kMaxTypoDistance + 2> prev(width + 1, bound + 1);
+    llvm::SmallVector<int, 2 * kMaxTypoDistance + 2> cur(width + 1, bound + 1);
+    for (int k = bound; k < width; ++k) {
+        prev[k] = k - bound;
+    }
+    for (int i = 1; i <= n; ++i) {
+        int row_min = bound + 1;
+        for (int k = 0; k < width; ++k) {
+            int j = i + k - bound;
+            int value = bound + 1;
+            if (j == 0) {
+                value = i;
+            } else if (j > 0 && j <= m) {
+                int cost = (wrong[i - 1] == good[j - 1]) ? 0 : 1;
+                value = std::min(prev[k] + cost, prev[k + 1] + 1);
+                if (k > 0) {
+                    value = std::min(value, cur[k - 1] + 1);
+                }
+            }
+            cur[k] = std::min(value, bound + 1);
+            row_min = std::min(row_min, cur[k]);
+        }
+        if (row_min > bound) {
+            return bound + 1;
+        }
+        std::swap(prev, cur);
+    }
+    return prev[m - n + bound];
+}
+
+// An identifier word prepared for many distance queries against dictionary words.
+// The identifier side is lowercased unless fold_case is false (dictionary words
+// compared with each other). Words of up to 64 characters use the bit-parallel
+// algorithm of Myers in Hyyro's formulation for the global edit distance, longer
+// ones fall back to BandedLevDistance.
+class LevPattern {
+public:
+    explicit LevPattern(std::string_view word, bool fold_case = true) : word_(word) {
+        if (fold_case) {
+            for (auto& c : word_) {
+                c = ToLower(c);
+            }
+        }
+        peq_.fill(0);
+        if (word_.size() <= 64) {
+            for (size_t i = 0; i < word_.size(); ++i) {
+                peq_[static_cast<unsigned char>(word_[i])] |= uint64_t{1} << i;
+            }
+        }
+    }
+
+    const std::string& Word() const {
+        return word_;
+    }
+
+    int Distance(std::string_view good) const {
+        return Distance(good, static_cast<int>(word_.size() + good.size()));
+    }
+
+    // Returns the distance if it does not exceed bound and bound + 1 otherwise.
+    int Distance(std::string_view good, int bound) const {
+        int n = static_cast<int>(word_.size());
+        int m = static_cast<int>(good.size());
+        if (std::abs(n - m) > bound) {
+            return bound + 1;
+        }
+        if (n == 0) {
+            return m;
+        }
+        if (n > 64) {
+            return BandedLevDistance(word_, good, bound);
+        }
+        uint64_t last = uint64_t{1} << (n - 1);
+        uint64_t pv = ~uint64_t{0};
+        uint64_t mv = 0;
+        int score = n;
+        for (int j = 0; j < m; ++j) {
+            uint64_t eq = peq_[static_cast<unsigned char>(good[j])];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & last) {
+                ++score;
+            } else if (mh & last) {
+                --score;
+            }
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            // Every remaining column can lower the score by at most one.
+            if (score - (m - j - 1) > bound) {
+                return bound + 1;
+            }
+        }
+        return score <= bound ? score : bound + 1;
+    }
+
+private:
+    std::string word_;
+    std::array<uint64_t, 256> peq_;
+};
+
+inline int CalcLevDistance(std::string_view wrong_name, std::string_view good_name) {
+    return LevPattern(wrong_name).Distance(good_name);
+}
@@ -0,0 +1,888 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSwitch.h>
+#include "run_stats.h"
+
+// The declarations of the lexer engine, recognized in the tokens of one file
+// without preprocessing it and without any semantic analysis. The result is
+// approximate: declarations made by macros are not seen, both branches of a
+// conditional directive are scanned, and an expression statement such as a * b;
+// reads as a declaration, as the grammar allows.
+
+enum class TokenKind { kIdentifier, kLiteral, kPunctuation };
+
+// Keywords come as identifiers, the text of a literal includes its quotes.
+struct ScanToken {
+    TokenKind kind;
+    llvm::StringRef text;
+    unsigned offset;
+    unsigned line;
+};
+
+// A declaration in the terms of the AST engines: the check it goes to and what
+// that check looks at. The line is the one the AST engines report: the line of
+// the name for variables and the line of the start of the declaration otherwise.
+struct ScannedDecl {
+    CheckKind kind;
+    std::string name;
+    unsigned offset;
+    unsigned line;
+    unsigned name_line;
+    bool is_const;
+    bool is_member;
+    bool is_public;
+};
+
+class DeclScanner {
+public:
+    // With decls_only, function bodies and parameters are skipped like -decls-only
+    // skips them in the AST.
+    DeclScanner(const std::vector<ScanToken>& tokens, bool decls_only)
+        : tokens_(tokens), decls_only_(decls_only) {
+        scopes_.push_back(Scope{ScopeKind::kNamespace, true, {}, false, {}});
+    }
+
+    // The declarations in the order of the file.
+    std::vector<ScannedDecl> Scan() {
+        bool start = true;
+        while (pos_ < tokens_.size()) {
+            auto text = tokens_[pos_].text;
+            if (text == "{") {
+                Open(ScopeKind::kBody);
+                start = true;
+            } else if (text == "}") {
+                Close();
+                start = true;
+            } else if (text == ";") {
+                ++pos_;
+                start = true;
+            } else if (start) {
+                start = Statement();
+            } else if (text == "]" && Is(pos_ + 1, "(")) {
+                // The parameters of a lambda.
+                ++pos_;
+                Parameters();
+            } else {
+                ++pos_;
+            }
+        }
+        return std::move(decls_);
+    }
+
+private:
+    enum class ScopeKind { kNamespace, kClass, kBody };
+
+    // The declaration specifiers: the type and what applies to all the declarators.
+    struct DeclSpec {
+        unsigned line = 0;
+        bool has_type = false;
+        bool is_const = false;
+        bool is_constexpr = false;
+        bool is_static = false;
+        bool is_typedef = false;
+        // The last two names of the type, for out-of-line constructors.
+        bool has_name = false;
+        size_t last_name = 0;
+        llvm::StringRef prev_name;
+    };
+
+    struct Declarator {
+        std::string name;
+        size_t token = 0;
+        bool is_pointer = false;
+        bool is_reference = false;
+        bool const_pointer = false;
+        bool is_qualified = false;
+        bool is_operator = false;
+    };
+
+    struct Scope {
+        ScopeKind kind;
+        bool is_public;
+        llvm::StringRef name;
+        // Declarators may follow the closing brace of a class defined in a statement.
+        bool trailing;
+        DeclSpec spec;
+    };
+
+    static bool IsKeyword(llvm::StringRef text) {
+        return llvm::StringSwitch<bool>(text)
+            .Cases("alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", true)
+            .Cases("bool", "break", "case", "catch", "char", "char8_t", "char16_t", "char32_t",
+                   true)
+            .Cases("class", "compl", "concept", "const", "consteval", "constexpr", "constinit",
+                   "const_cast", true)
+            .Cases("continue", "co_await", "co_return", "co_yield", "decltype", "default",
+                   "delete", "do", true)
+            .Cases("double", "dynamic_cast", "else", "enum", "explicit", "export", "extern",
+                   "false", true)
+            .Cases("float", "for", "friend", "goto", "if", "inline", "int", "long", true)
+            .Cases("mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr",
+                   "operator", true)
+            .Cases("or", "or_eq", "private", "protected", "public", "register",
+                   "reinterpret_cast", "requires", true)
+            .Cases("return", "short", "signed", "sizeof", "static", "static_assert",
+                   "static_cast", "struct", true)
+            .Cases("switch", "template", "this", "thread_local", "throw", "true", "try",
+                   "typedef", true)
+            .Cases("typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+                   "volatile", true)
+            .Cases("wchar_t", "while", "xor", "xor_eq", true)
+            .Default(false);
+    }
+
+    static bool IsBuiltinType(llvm::StringRef text) {
+        return llvm::StringSwitch<bool>(text)
+            .Cases("void", "bool", "char", "char8_t", "char16_t", "char32_t", "wchar_t", true)
+            .Cases("short", "int", "long", "float", "double", "signed", "unsigned", "auto", true)
+            .Default(false);
+    }
+
+    // The specifiers that say nothing about the check of the declaration.
+    static bool IsSpecifier(llvm::StringRef text) {
+        return llvm::StringSwitch<bool>(text)
+            .Cases("inline", "extern", "mutable", "thread_local", "virtual", "explicit", true)
+            .Cases("register", "constinit", "typename", "volatile", "export", true)
+            .Default(false);
+    }
+
+    bool Is(size_t i, llvm::StringRef text) const {
+        return i < tokens_.size() && tokens_[i].kind != TokenKind::kLiteral &&
+               tokens_[i].text == text;
+    }
+
+    bool Is(llvm::StringRef text) const {
+        return Is(pos_, text);
+    }
+
+    bool IsName(size_t i) const {
+        return i < tokens_.size() && tokens_[i].kind == TokenKind::kIdentifier &&
+               !IsKeyword(tokens_[i].text);
+    }
+
+    ScopeKind Kind() const {
+        return scopes_.back().kind;
+    }
+
+    void Add(CheckKind kind, llvm::StringRef name, size_t token, unsigned line,
+             bool is_const = false) {
+        const auto& scope = scopes_.back();
+        decls_.push_back({kind, name.str(), tokens_[token].offset, line, tokens_[token].line,
+                          is_const, scope.kind == ScopeKind::kClass, scope.is_public});
+    }
+
+    // Skips the group opened at pos_ with its nested groups of the same kind.
+    void Skip(llvm::StringRef open, llvm::StringRef close) {
+        int depth = 0;
+        do {
+            depth += Is(open) ? 1 : Is(close) ? -1 : 0;
+            ++pos_;
+        } while (depth > 0 && pos_ < tokens_.size());
+    }
+
+    // Skips the (), [] or {} group opened at pos_.
+    void SkipGroup() {
+        auto open = tokens_[pos_].text;
+        Skip(open, open == "(" ? ")" : open == "[" ? "]" : "}");
+    }
+
+    // Template arguments; fails on a token that cannot be in them, such as that of a
+    // comparison in an expression.
+    bool SkipAngles() {
+        size_t start = pos_;
+        int depth = 0;
+        while (pos_ < tokens_.size()) {
+            if (Is("(") || Is("[")) {
+                SkipGroup();
+                continue;
+            }
+            if (Is(";") || Is("{") || Is("}") || Is(")")) {
+                break;
+            }
+            depth += Is("<") ? 1 : Is(">") ? -1 : Is(">>") ? -2 : 0;
+            ++pos_;
+            if (depth <= 0) {
+                return true;
+            }
+        }
+        pos_ = start;
+        return false;
+    }
+
+    void SkipAttributes() {
+        while (pos_ < tokens_.size()) {
+            if (Is("[") && Is(pos_ + 1, "[")) {
+                Skip("[", "]");
+            } else if ((Is("alignas") || Is("__attribute__") || Is("__declspec")) &&
+                       Is(pos_ + 1, "(")) {
+                ++pos_;
+                Skip("(", ")");
+            } else {
+                break;
+            }
+        }
+    }
+
+    // Skips to the end of the statement, a braced block included.
+    void SkipStatement() {
+        while (pos_ < tokens_.size() && !Is(";") && !Is("}")) {
+            if (Is("{")) {
+                Skip("{", "}");
+                if (Is(";")) {
+                    ++pos_;
+                }
+                return;
+            }
+            if (Is("(") || Is("[")) {
+                SkipGroup();
+            } else {
+                ++pos_;
+            }
+        }
+        if (Is(";")) {
+            ++pos_;
+        }
+    }
+
+    // Skips an initializer up to the , ; or unmatched ) after it and parses the
+    // lambdas on the way. Returns false at a brace, the main loop takes it over.
+    bool SkipInitializer() {
+        int depth = 0;
+        while (pos_ < tokens_.size()) {
+            if (Is("{") || Is("}")) {
+                return false;
+            }
+            if (Is("]") && Is(pos_ + 1, "(")) {
+                --depth;
+                ++pos_;
+                Parameters();
+                continue;
+            }
+            if (Is("(") || Is("[")) {
+                ++depth;
+            } else if (Is(")") || Is("]")) {
+                if (depth == 0) {
+                    return true;
+                }
+                --depth;
+            } else if (depth == 0 && (Is(",") || Is(";"))) {
+                return true;
+            }
+            ++pos_;
+        }
+        return true;
+    }
+
+    void Open(ScopeKind kind, llvm::StringRef name = {}, bool is_public = true) {
+        if (decls_only_ && kind == ScopeKind::kBody) {
+            Skip("{", "}");
+            return;
+        }
+        scopes_.push_back(Scope{kind, is_public, name, false, {}});
+        ++pos_;
+    }
+
+    void Close() {
+        ++pos_;
+        if (scopes_.size() == 1) {
+            return;
+        }
+        auto scope = scopes_.back();
+        scopes_.pop_back();
+        if (scope.trailing && !Is(";")) {
+            Trailing(scope.spec);
+        }
+    }
+
+    // The declarators after the body of a class or an enum, typedef names if it
+    // was defined in a typedef.
+    void Trailing(DeclSpec spec) {
+        spec.has_type = true;
+        Declarator declarator;
+        if (ParseDeclarator(declarator)) {
+            Declarators(spec, declarator);
+        }
+    }
+
+    // Returns whether the next token starts a statement.
+    bool Statement() {
+        const auto& token = tokens_[pos_];
+        if (token.kind != TokenKind::kIdentifier) {
+            DeclSpec spec;
+            spec.line = token.line;
+            return (Is("~") || Is("::") || Is("[")) && Declaration(spec);
+        }
+        auto text = token.text;
+        if (text == "namespace") {
+            ++pos_;
+            while (IsName(pos_) || Is("::") || Is("inline")) {
+                ++pos_;
+            }
+            SkipAttributes();
+            if (Is("{")) {
+                Open(ScopeKind::kNamespace);
+            } else {
+                SkipStatement();
+            }
+            return true;
+        }
+        if (text == "template") {
+            ++pos_;
+            if (Is("<")) {
+                SkipAngles();
+            } else {
+                // An explicit instantiation.
+                SkipStatement();
+            }
+            return true;
+        }
+        if (text == "using") {
+            ++pos_;
+            if (IsName(pos_) && Is(pos_ + 1, "=")) {
+                Add(CheckKind::kTypeAlias, tokens_[pos_].text, pos_, token.line);
+            }
+            SkipStatement();
+            return true;
+        }
+        if ((text == "public" || text == "private" || text == "protected") &&
+            Is(pos_ + 1, ":")) {
+            scopes_.back().is_public = text == "public";
+            pos_ += 2;
+            return true;
+        }
+        if (text == "friend" || text == "static_assert" || text == "asm") {
+            SkipStatement();
+            return true;
+        }
+        if (text == "extern" && pos_ + 1 < tokens_.size() &&
+            tokens_[pos_ + 1].kind == TokenKind::kLiteral) {
+            pos_ += 2;
+            if (Is("{")) {
+                Open(ScopeKind::kNamespace);
+            }
+            return true;
+        }
+        if (text == "if" || text == "while" || text == "switch" || text == "for" ||
+            text == "catch") {
+            return Condition();
+        }
+        if (text == "else" || text == "do" || text == "try") {
+            ++pos_;
+            return true;
+        }
+        if (text == "case" || (text == "default" && Is(pos_ + 1, ":"))) {
+            while (pos_ < tokens_.size() && !Is(":") && !Is(";") && !Is("{") && !Is("}")) {
+                ++pos_;
+            }
+            if (Is(":")) {
+                ++pos_;
+            }
+            return true;
+        }
+        DeclSpec spec;
+        spec.line = token.line;
+        if (text == "typedef") {
+            spec.is_typedef = true;
+            ++pos_;
+            text = pos_ < tokens_.size() ? tokens_[pos_].text : "";
+        }
+        if (text == "class" || text == "struct" || text == "union" || text == "enum") {
+            return Record(spec);
+        }
+        if (IsKeyword(text) && !IsBuiltinType(text) && !IsSpecifier(text) && text != "const" &&
+            text != "constexpr" && text != "consteval" && text != "static" &&
+            text != "decltype" && text != "alignas") {
+            return false;
+        }
+        return Declaration(spec);
+    }
+
+    // The condition of if, while and switch, the head of for and the parameter of
+    // catch. Only the first variable declared there is found.
+    bool Condition() {
+        auto keyword = tokens_[pos_].text;
+        ++pos_;
+        if (Is("constexpr")) {
+            ++pos_;
+        }
+        if (!Is("(")) {
+            return false;
+        }
+        size_t end = pos_;
+        Skip("(", ")");
+        std::swap(end, pos_);
+        ++pos_;
+        DeclSpec spec;
+        spec.line = pos_ < tokens_.size() ? tokens_[pos_].line : 0;
+        Declarator declarator;
+        if (DeclSpecifiers(spec) && spec.has_type && ParseDeclarator(declarator) &&
+            !declarator.name.empty()) {
+            bool declared = Is("=") || Is("{");
+            if (keyword == "for") {
+                declared = declared || Is(":") || Is(";");
+            } else if (keyword == "catch") {
+                declared = Is(")");
+            }
+            if (declared) {
+                AddVariable(spec, declarator);
+            }
+        }
+        pos_ = end;
+        return true;
+    }
+
+    // class, struct, union or enum: a definition, a forward declaration or the type
+    // of a declaration.
+    bool Record(DeclSpec spec) {
+        size_t start = pos_;
+        const auto& keyword = tokens_[pos_];
+        bool is_enum = keyword.text == "enum";
+        bool is_public = keyword.text != "class";
+        ++pos_;
+        if (is_enum && (Is("class") || Is("struct"))) {
+            ++pos_;
+        }
+        SkipAttributes();
+        size_t name = 0;
+        while (IsName(pos_)) {
+            name = pos_++;
+            if (Is("<") && !SkipAngles()) {
+                break;
+            }
+            if (!Is("::")) {
+                break;
+            }
+            ++pos_;
+        }
+        if (name != 0 && Is("final")) {
+            ++pos_;
+        }
+        if (Is(":")) {
+            // The bases of a class, the underlying type of an enum.
+            while (pos_ < tokens_.size() && !Is("{") && !Is(";") && !Is("}")) {
+                ++pos_;
+            }
+        }
+        auto kind = is_enum ? CheckKind::kEnum : CheckKind::kRecord;
+        if (Is("{")) {
+            if (name != 0) {
+                Add(kind, tokens_[name].text, name, keyword.line);
+            }
+            spec.has_type = true;
+            if (is_enum) {
+                Skip("{", "}");
+                if (!Is(";")) {
+                    Trailing(spec);
+                }
+                return true;
+            }
+            Open(ScopeKind::kClass, name != 0 ? tokens_[name].text : "", is_public);
+            scopes_.back().trailing = true;
+            scopes_.back().spec = spec;
+            return true;
+        }
+        if (Is(";") && name != 0 && !spec.is_typedef) {
+            Add(kind, tokens_[name].text, name, keyword.line);
+            ++pos_;
+            return true;
+        }
+        pos_ = start;
+        return Declaration(spec);
+    }
+
+    // Parses the specifiers, fails on what cannot be a type.
+    bool DeclSpecifiers(DeclSpec& spec) {
+        while (pos_ < tokens_.size()) {
+            SkipAttributes();
+            if (pos_ >= tokens_.size()) {
+                break;
+            }
+            const auto& token = tokens_[pos_];
+            if (token.kind != TokenKind::kIdentifier) {
+                if (Is("::") && !spec.has_type) {
+                    if (!TypeName(spec)) {
+                        return false;
+                    }
+                    continue;
+                }
+                break;
+            }
+            auto text = token.text;
+            if (text == "const") {
+                spec.is_const = true;
+                ++pos_;
+            } else if (text == "constexpr" || text == "consteval") {
+                spec.is_constexpr = true;
+                ++pos_;
+            } else if (text == "static") {
+                spec.is_static = true;
+                ++pos_;
+            } else if (IsSpecifier(text)) {
+                ++pos_;
+                if (text == "explicit" && Is("(")) {
+                    Skip("(", ")");
+                }
+            } else if (text == "decltype") {
+                ++pos_;
+                if (Is("(")) {
+                    Skip("(", ")");
+                }
+                spec.has_type = true;
+            } else if (IsBuiltinType(text)) {
+                spec.has_type = true;
+                ++pos_;
+            } else if (text == "class" || text == "struct" || text == "union" ||
+                       text == "enum") {
+                ++pos_;
+                if (!TypeName(spec)) {
+                    return false;
+                }
+            } else if (IsKeyword(text) || spec.has_type) {
+                break;
+            } else if (!TypeName(spec)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A possibly qualified type name with template arguments. A :: followed by ~
+    // is left to the declarator of a destructor.
+    bool TypeName(DeclSpec& spec) {
+        if (Is("::")) {
+            ++pos_;
+        }
+        while (IsName(pos_) || Is("template")) {
+            if (Is("template")) {
+                ++pos_;
+                continue;
+            }
+            spec.prev_name = spec.has_name ? tokens_[spec.last_name].text : "";
+            spec.has_name = true;
+            spec.last_name = pos_++;
+            if (Is("<") && !SkipAngles()) {
+                return false;
+            }
+            if (!Is("::") || !(IsName(pos_ + 1) || Is(pos_ + 1, "template"))) {
+                break;
+            }
+            ++pos_;
+        }
+        spec.has_type = true;
+        return true;
+    }
+
+    // The pointer operators and the name of a declarator. An abstract declarator,
+    // without a name, leaves an empty name.
+    bool ParseDeclarator(Declarator& declarator) {
+        while (pos_ < tokens_.size()) {
+            if (Is("*")) {
+                declarator.is_pointer = true;
+                declarator.const_pointer = false;
+            } else if (Is("&") || Is("&&")) {
+                declarator.is_reference = true;
+            } else if (Is("const")) {
+                declarator.const_pointer = declarator.is_pointer;
+            } else if (!Is("volatile") && !Is("__restrict") && !Is("...")) {
+                break;
+            }
+            ++pos_;
+        }
+        SkipAttributes();
+        if (Is("(") && (Is(pos_ + 1, "*") || Is(pos_ + 1, "&") || Is(pos_ + 1, "^"))) {
+            // A pointer to a function or an array.
+            ++pos_;
+            Declarator inner;
+            if (!ParseDeclarator(inner) || !Is(")")) {
+                return false;
+            }
+            ++pos_;
+            while (Is("(") || Is("[")) {
+                SkipGroup();
+            }
+            declarator = inner;
+            return true;
+        }
+        if (Is("::")) {
+            ++pos_;
+            declarator.is_qualified = true;
+        }
+        while (IsName(pos_)) {
+            size_t start = pos_++;
+            if (Is("<")) {
+                SkipAngles();
+            }
+            if (!Is("::")) {
+                pos_ = start;
+                break;
+            }
+            ++pos_;
+            declarator.is_qualified = true;
+        }
+        if (Is("~") && IsName(pos_ + 1)) {
+            declarator.name = "~" + tokens_[pos_ + 1].text.str();
+            declarator.token = pos_ + 1;
+            pos_ += 2;
+            return true;
+        }
+        if (Is("operator")) {
+            declarator.name = "operator";
+            declarator.token = pos_;
+            declarator.is_operator = true;
+            ++pos_;
+            if (Is("(")) {
+                pos_ += 2;
+            }
+            while (pos_ < tokens_.size() && !Is("(") && !Is(";") && !Is("{")) {
+                ++pos_;
+            }
+            return true;
+        }
+        if (IsName(pos_)) {
+            declarator.name = tokens_[pos_].text.str();
+            declarator.token = pos_++;
+            return true;
+        }
+        return !declarator.is_qualified && pos_ < tokens_.size() &&
+               (Is(",") || Is(")") || Is("=") || Is("["));
+    }
+
+    // A declaration at the start of a statement.
+    bool Declaration(DeclSpec spec) {
+        SkipAttributes();
+        if (!DeclSpecifiers(spec)) {
+            return false;
+        }
+        Declarator declarator;
+        bool is_constructor = false;
+        if (Kind() != ScopeKind::kBody && spec.has_type && spec.has_name && Is("(")) {
+            // The type is the name of a constructor: Name( in its class, Name::Name(
+            // out of it.
+            auto name = tokens_[spec.last_name].text;
+            is_constructor = Kind() == ScopeKind::kClass ? name == scopes_.back().name
+                                                         : name == spec.prev_name;
+            if (is_constructor) {
+                declarator.name = name.str();
+                declarator.token = spec.last_name;
+                declarator.is_qualified = Kind() != ScopeKind::kClass;
+            }
+        }
+        if (!is_constructor) {
+            if ((!spec.has_type && !Is("~") && !Is("::")) || !ParseDeclarator(declarator) ||
+                declarator.name.empty()) {
+                return false;
+            }
+        }
+        return Declarators(spec, declarator);
+    }
+
+    bool IsFunction(const Declarator& declarator) const {
+        return Is("(") && (Kind() != ScopeKind::kBody || declarator.is_operator ||
+                           declarator.is_qualified || declarator.name[0] == '~');
+    }
+
+    // The declarators of a declaration, the first one parsed. Returns whether the
+    // statement is over.
+    bool Declarators(const DeclSpec& spec, Declarator declarator) {
+        while (true) {
+            if (spec.is_typedef) {
+                Add(CheckKind::kTypeDef, declarator.name, declarator.token, spec.line);
+                while (Is("(") || Is("[")) {
+                    SkipGroup();
+                }
+            } else if (IsFunction(declarator)) {
+                if (Function(spec, declarator)) {
+                    return true;
+                }
+            } else {
+                while (Is("[")) {
+                    Skip("[", "]");
+                }
+                if (!Is("=") && !Is("{") && !Is("(") && !Is(";") && !Is(",") && !Is(":")) {
+                    return false;
+                }
+                AddVariable(spec, declarator);
+                if (Is(":") && Kind() == ScopeKind::kClass) {
+                    // A bit-field.
+                    ++pos_;
+                    if (!SkipInitializer()) {
+                        return false;
+                    }
+                } else if (Is("=")) {
+                    ++pos_;
+                    if (!SkipInitializer()) {
+                        return false;
+                    }
+                } else if (Is("{") || Is("(")) {
+                    SkipGroup();
+                }
+            }
+            if (Is(";")) {
+                ++pos_;
+                return true;
+            }
+            if (!Is(",")) {
+                return false;
+            }
+            ++pos_;
+            declarator = Declarator();
+            if (!ParseDeclarator(declarator) || declarator.name.empty()) {
+                return false;
+            }
+        }
+    }
+
+    void AddVariable(const DeclSpec& spec, const Declarator& declarator) {
+        bool is_const = declarator.is_pointer ? declarator.const_pointer
+                                              : spec.is_const && !declarator.is_reference;
+        is_const = is_const || spec.is_constexpr;
+        if (Kind() == ScopeKind::kClass && !spec.is_static) {
+            Add(CheckKind::kField, declarator.name, declarator.token, spec.line, is_const);
+        } else {
+            auto line = tokens_[declarator.token].line;
+            Add(CheckKind::kVar, declarator.name, declarator.token, line, is_const);
+        }
+    }
+
+    // A function declarator at its parameters. Returns whether the statement is over:
+    // a declaration ended by ; or a definition, whose body is opened. Otherwise it is
+    // not a function after all, the name is checked as a variable.
+    bool Function(const DeclSpec& spec, const Declarator& declarator) {
+        size_t count = decls_.size();
+        // Operators and main are not checked, as in CheckDecl.
+        if (!declarator.is_operator && !(declarator.name == "main" && scopes_.size() == 1)) {
+            Add(CheckKind::kFunction, declarator.name, declarator.token, spec.line);
+        }
+        if (!Parameters()) {
+            decls_.resize(count);
+            AddVariable(spec, declarator);
+            Skip("(", ")");
+            return false;
+        }
+        // The qualifiers and the trailing return type.
+        while (pos_ < tokens_.size()) {
+            if (Is("noexcept") || Is("throw") || Is("requires")) {
+                ++pos_;
+                if (Is("(")) {
+                    Skip("(", ")");
+                }
+            } else if (Is("->")) {
+                ++pos_;
+                DeclSpec type;
+                if (!DeclSpecifiers(type)) {
+                    return false;
+                }
+                Declarator abstract;
+                ParseDeclarator(abstract);
+            } else if (Is("const") || Is("volatile") || Is("&") || Is("&&") || Is("override") ||
+                       Is("final") || Is("try")) {
+                ++pos_;
+            } else if (Is("[") && Is(pos_ + 1, "[")) {
+                SkipAttributes();
+            } else {
+                break;
+            }
+        }
+        if (Is("=")) {
+            // = 0, = default or = delete.
+            pos_ += 2;
+        }
+        if (Is(":")) {
+            // The member initializers of a constructor.
+            ++pos_;
+            while (pos_ < tokens_.size()) {
+                DeclSpec member;
+                if (!TypeName(member) || !(Is("(") || Is("{"))) {
+                    return false;
+                }
+                SkipGroup();
+                if (Is("...")) {
+                    ++pos_;
+                }
+                if (!Is(",")) {
+                    break;
+                }
+                ++pos_;
+            }
+        }
+        if (Is("{")) {
+            Open(ScopeKind::kBody);
+            return true;
+        }
+        if (Is(";")) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    // The parameters in the parentheses at pos_, they are declared as variables.
+    // Fails on what cannot be a parameter, such as the arguments of a call, and
+    // leaves pos_ at the parenthesis then.
+    bool Parameters() {
+        size_t start = pos_;
+        size_t count = decls_.size();
+        ++pos_;
+        while (!Is(")")) {
+            if (Is("...")) {
+                ++pos_;
+            } else {
+                DeclSpec spec;
+                spec.line = pos_ < tokens_.size() ? tokens_[pos_].line : 0;
+                Declarator declarator;
+                if (!DeclSpecifiers(spec) || !spec.has_type || !ParseDeclarator(declarator)) {
+                    break;
+                }
+                // A parameter of array type is a pointer to the elements, their const
+                // does not make it a constant.
+                bool is_array = false;
+                while (Is("(") || Is("[")) {
+                    is_array = is_array || Is("[");
+                    SkipGroup();
+                }
+                if (!declarator.name.empty() && !decls_only_) {
+                    auto line = tokens_[declarator.token].line;
+                    bool is_const = declarator.is_pointer
+                                        ? declarator.const_pointer
+                                        : spec.is_const && !declarator.is_reference && !is_array;
+                    decls_.push_back({CheckKind::kVar, declarator.name,
+                                      tokens_[declarator.token].offset, line, line, is_const,
+                                      false, true});
+                }
+                if (Is("=")) {
+                    // A default argument.
+                    ++pos_;
+                    while (pos_ < tokens_.size() && !Is(",") && !Is(")") && !Is(";")) {
+                        if (Is("(") || Is("[") || Is("{")) {
+                            SkipGroup();
+                        } else {
+                            ++pos_;
+                        }
+                    }
+                }
+            }
+            if (Is(",")) {
+                ++pos_;
+            } else if (!Is(")")) {
+                break;
+            }
+        }
+        if (!Is(")")) {
+            decls_.resize(count);
+            pos_ = start;
+            return false;
+        }
+        ++pos_;
+        return true;
+    }
+
+    const std::vector<ScanToken>& tokens_;  // NOLINT
+    bool decls_only_;                        // NOLINT
+    size_t pos_ = 0;                         // NOLINT
+    std::vector<Scope> scopes_;              // NOLINT
+    std::vector<ScannedDecl> decls_;         // NOLINT
+};
@@ -0,0 +1,163 @@
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cctype>
+#include <string>
+#include <vector>
+#include "lexer_scan.h"
+
+// The declarations DeclScanner finds in token sequences, against those the AST
+// engines report for the same code. The sources are written with the tokens
+// separated by spaces, a new line starts a new source line. Exits with 1 if any
+// case differs.
+
+struct Case {
+    const char* name;
+    const char* source;
+    // "<check> <name>", followed by "const" for a constant and "private" for a
+    // private member.
+    std::vector<std::string> decls;
+    bool decls_only = false;
+};
+
+std::vector<ScanToken> Tokens(llvm::StringRef source) {
+    std::vector<ScanToken> tokens;
+    unsigned line = 1;
+    size_t pos = 0;
+    while (pos < source.size()) {
+        if (source[pos] == '\n') {
+            ++line;
+        }
+        if (std::isspace(static_cast<unsigned char>(source[pos]))) {
+            ++pos;
+            continue;
+        }
+        size_t end = source.find_first_of(" \n", pos);
+        auto text = source.slice(pos, end);
+        auto kind = TokenKind::kPunctuation;
+        if (std::isalpha(static_cast<unsigned char>(text[0])) || text[0] == '_') {
+            kind = TokenKind::kIdentifier;
+        } else if (std::isdigit(static_cast<unsigned char>(text[0])) || text[0] == '"' ||
+                   text[0] == '\'') {
+            kind = TokenKind::kLiteral;
+        }
+        tokens.push_back({kind, text, static_cast<unsigned>(pos), line});
+        pos = text.end() - source.begin();
+    }
+    return tokens;
+}
+
+std::string Describe(const ScannedDecl& decl) {
+    static const char* const kChecks[] = {"var",  "field", "function", "record",
+                                          "enum", "alias", "typedef"};
+    std::string text = std::string(kChecks[static_cast<size_t>(decl.kind)]) + " " + decl.name;
+    if (decl.is_const) {
+        text += " const";
+    }
+    if (decl.is_member && !decl.is_public) {
+        text += " private";
+    }
+    return text;
+}
+
+std::vector<Case> Cases() {
+    return {
+        // Classes, constructors and destructors, which are checked as functions.
+        {"class", "class Shape { public : int Area ( ) const ; private : int side_ ; } ;",
+         {"record Shape", "function Area", "field side_ private"}},
+        {"struct", "struct Point { int x ; int y = 0 ; } ;",
+         {"record Point", "field x", "field y"}},
+        {"constructor",
+         "class Timer {\n public : Timer ( int period ) : period_ ( period ) { }\n"
+         " explicit Timer ( ) = default ; ~ Timer ( ) ;\n private : int period_ ; } ;",
+         {"record Timer", "function Timer", "var period", "function Timer", "function ~Timer",
+          "field period_ private"}},
+        {"out-of-line constructor", "Timer :: Timer ( int period ) : period_ { period } { }",
+         {"function Timer", "var period"}},
+        {"static member", "struct Limits { static const int kMax = 4 ; static int count ; } ;",
+         {"record Limits", "var kMax const", "var count"}},
+        {"enum", "enum class Color { kRed , kGreen } ; enum Flags : unsigned { kNone } ;",
+         {"enum Color", "enum Flags"}},
+        // Templates and lambdas.
+        {"template",
+         "template < class T , int N > class Buffer { T items_ [ N ] ; } ;\n"
+         "template < class T > T Max ( T lhs , T rhs ) { return lhs ; }",
+         {"record Buffer", "field items_ private", "function Max", "var lhs", "var rhs"}},
+        {"template arguments",
+         "std :: map < std :: string , std :: vector < int >> index ;\n"
+         "std :: array < int , 3 > sizes { } ;",
+         {"var index", "var sizes"}},
+        {"lambda",
+         "void Run ( ) { auto add = [ ] ( int lhs , int rhs ) { return lhs + rhs ; } ;\n"
+         " Apply ( [ & ] ( const Item & item ) { Use ( item ) ; } ) ; }",
+         {"function Run", "var add", "var lhs", "var rhs", "var item"}},
+        // Declarations in the headers of for and if.
+        {"for",
+         "void Loop ( ) { for ( int i = 0 ; i < n ; ++ i ) { }\n"
+         " for ( const auto & item : items ) { } }",
+         {"function Loop", "var i", "var item"}},
+        {"if init",
+         "void Find ( ) { if ( auto it = map . find ( key ) ; it != map . end ( ) ) { }\n"
+         " while ( Node * node = Next ( ) ) { } }",
+         {"function Find", "var it", "var node"}},
+        // Calls and expressions that are not declarations.
+        {"calls",
+         "void Call ( ) { Print ( value ) ; object . Method ( a , b ) ;\n"
+         " pointer -> Method ( ) ; std :: sort ( begin , end ) ; }",
+         {"function Call"}},
+        {"expressions",
+         "void Compute ( ) { total = a + b ; count ++ ; -- left ; x [ 0 ] = y ;\n"
+         " std :: cout << value << std :: endl ; return a < b ; }",
+         {"function Compute"}},
+        {"new and delete",
+         "void Own ( ) { delete pointer ; throw Error ( ) ; return new Node ( ) ; }",
+         {"function Own"}},
+        // Type aliases.
+        {"typedef", "typedef unsigned long Size ; typedef void ( * Handler ) ( int ) ;",
+         {"typedef Size", "typedef Handler"}},
+        {"using",
+         "using Names = std :: vector < std :: string > ;\n"
+         "template < class T > using Ptr = T * ; using std :: string ; using namespace std ;",
+         {"alias Names", "alias Ptr"}},
+        // Operators are not checked, their parameters are.
+        {"operators",
+         "struct Money { Money & operator += ( const Money & other ) ;\n"
+         " bool operator == ( const Money & rhs ) const ; operator bool ( ) const ; } ;\n"
+         "Money operator + ( Money lhs , Money rhs ) ;",
+         {"record Money", "var other", "var rhs", "var lhs", "var rhs"}},
+        // Constness.
+        {"constants",
+         "const int kSize = 1 ; constexpr char kName [ ] = \"x\" ;\n"
+         "const int kSizes [ ] = { 1 , 2 } ; const char * name ; char * const kPointer = 0 ;\n"
+         "const int & ref = kSize ;",
+         {"var kSize const", "var kName const", "var kSizes const", "var name",
+          "var kPointer const", "var ref"}},
+        {"array parameter", "void Fill ( const int sizes [ ] , const int kCount ) ;",
+         {"function Fill", "var sizes", "var kCount const"}},
+        {"declarations only",
+         "int Sum ( int lhs , int rhs ) { int total = lhs + rhs ; return total ; }",
+         {"function Sum"},
+         true},
+    };
+}
+
+int main() {
+    int failures = 0;
+    for (const auto& test : Cases()) {
+        auto tokens = Tokens(test.source);
+        std::vector<std::string> decls;
+        for (const auto& decl : DeclScanner(tokens, test.decls_only).Scan()) {
+            decls.push_back(Describe(decl));
+        }
+        if (decls != test.decls) {
+            llvm::errs() << test.name << ": expected [" << llvm::join(test.decls, ", ")
+                         << "], found [" << llvm::join(decls, ", ") << "]\n";
+            ++failures;
+        }
+    }
+    if (failures > 0) {
+        return 1;
+    }
+    llvm::outs() << "Lexer engine: all declaration cases pass\n";
+    return 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Regex.h>
+
+// The files outside of the system headers whose declarations are checked, for the
+// libraries a project keeps in its tree and includes with -I. A header is checked
+// only if it matches the header filter (when there is one), any file is dropped if
+// it matches one of the exclusions. The patterns are regular expressions matched
+// against the full path and compiled once; Regex::match is const and keeps no state
+// between calls, so one filter serves all the threads.
+class PathFilter {
+public:
+    static llvm::Expected<std::unique_ptr<PathFilter>> Create(
+        const std::string& header_filter, const std::vector<std::string>& excludes) {
+        auto filter = std::make_unique<PathFilter>();
+        std::string error;
+        if (!header_filter.empty()) {
+            filter->header_filter_.emplace(header_filter);
+            if (!filter->header_filter_->isValid(error)) {
+                return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                               "-header-filter %s: %s", header_filter.c_str(),
+                                               error.c_str());
+            }
+        }
+        for (const auto& pattern : excludes) {
+            filter->excludes_.emplace_back(pattern);
+            if (!filter->excludes_.back().isValid(error)) {
+                return llvm::createStringError(llvm::inconvertibleErrorCode(), "-exclude %s: %s",
+                                               pattern.c_str(), error.c_str());
+            }
+        }
+        filter->key_ = header_filter;
+        for (const auto& pattern : excludes) {
+            filter->key_.append("\n").append(pattern);
+        }
+        return filter;
+    }
+
+    bool Accepts(llvm::StringRef path, bool main_file) const {
+        if (!main_file && header_filter_ && !header_filter_->match(path)) {
+            return false;
+        }
+        for (const auto& pattern : excludes_) {
+            if (pattern.match(path)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The patterns, for the keys of results that depend on them.
+    const std::string& Key() const {
+        return key_;
+    }
+
+private:
+    std::optional<llvm::Regex> header_filter_;  // NOLINT
+    std::vector<llvm::Regex> excludes_;          // NOLINT
+    std::string key_;                            // NOLINT
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/raw_ostream.h>
+#include "print.h"
+
+// The strings of the findings of a run. Each distinct string is stored once in an
+// arena, the handles stay valid until the pool is cleared at the end of the run.
+class StringPool {
+public:
+    llvm::StringRef Intern(llvm::StringRef text) {
+        if (text.empty()) {
+            return {};
+        }
+        std::lock_guard lock(mutex_);
+        if (!saver_) {
+            saver_.emplace(allocator_);
+        }
+        return saver_->save(text);
+    }
+
+    // Frees every string, no finding of the run may be used afterwards.
+    void Clear() {
+        std::lock_guard lock(mutex_);
+        saver_.reset();
+        allocator_.Reset();
+    }
+
+    size_t MemoryUsage() const {
+        return allocator_.getBytesAllocated();
+    }
+
+private:
+    std::mutex mutex_;                              // NOLINT
+    llvm::BumpPtrAllocator allocator_;              // NOLINT
+    std::optional<llvm::UniqueStringSaver> saver_;  // NOLINT
+};
+
+// A finding. The strings are handles into the string pool of the run, the
+// dictionary word points into the dictionary, so a record owns no memory.
+struct BadNames {
+    Entity entity;
+    llvm::StringRef name;
+    llvm::StringRef file_name;
+    unsigned int number;
+    bool bad_mistake = true;
+    llvm::StringRef good_name = "";
+    llvm::StringRef wrong_name = "";
+};
+
+struct FileReport {
+    std::string file_name;
+    std::vector<BadNames> bad_names;
+};
+
+enum class ReportFormat { kText, kJsonLines, kSarif };
+
+// Receives the report file block by file block, in the final order, as soon as a
+// block is complete. Nothing is kept after a call returns, so the memory use does
+// not depend on the number of findings. The reporters are owned by their concrete
+// type and never deleted through this interface.
+class Reporter {
+public:
+    // Starts the block of a unit, or of a header in the -header-report=once section.
+    virtual void BeginFile(const std::string& file_name, int bad_names, int mistakes) = 0;
+    // A finding of the current block, typos already have the dictionary word.
+    virtual void Report(const BadNames& item) = 0;
+    // Called once after the last block.
+    virtual void Finish() = 0;
+
+protected:
+    ~Reporter() = default;
+};
+
+inline std::string_view BaseName(std::string_view path) {
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+// The human-readable format of print.h.
+class TextReporter : public Reporter {
+public:
+    explicit TextReporter(llvm::raw_ostream& os = llvm::outs()) : os_(os) {
+    }
+
+    void BeginFile(const std::string& file_name, int bad_names, int mistakes) override {
+        PrintStatistics(BaseName(file_name), bad_names, mistakes, os_);
+    }
+
+    void Report(const BadNames& item) override {
+        if (item.bad_mistake) {
+            BadName(item.entity, item.name, BaseName(item.file_name), item.number, os_);
+        } else {
+            Mistake(item.name, item.wrong_name, item.good_name, BaseName(item.file_name),
+                    item.number, os_);
+        }
+    }
+
+    void Finish() override {
+        os_.flush();
+    }
+
+private:
+    llvm::raw_ostream& os_;  // NOLINT
+};
+
+// One JSON object per line: a "file" record with the counts before the findings of
+// each block, then one "name" or "typo" record per finding. Paths are kept in full.
+class JsonLinesReporter : public Reporter {
+public:
+    explicit JsonLinesReporter(llvm::raw_ostream& os = llvm::outs()) : os_(os) {
+    }
+
+    void BeginFile(const std::string& file_name, int bad_names, int mistakes) override {
+        file_name_ = file_name;
+        os_ << llvm::json::Value(llvm::json::Object{{"kind", "file"},
+                                                    {"file", file_name},
+                                                    {"bad_names", bad_names},
+                                                    {"mistakes", mistakes}})
+            << "\n";
+    }
+
+    void Report(const BadNames& item) override {
+        llvm::json::Object record{{"unit", file_name_},
+                                  {"file", item.file_name},
+                                  {"line", item.number},
+                                  {"name", item.name}};
+        if (item.bad_mistake) {
+            record["kind"] = "name";
+            record["entity"] = Str(item.entity);
+        } else {
+            record["kind"] = "typo";
+            record["word"] = item.wrong_name;
+            record["suggestion"] = item.good_name;
+        }
+        os_ << llvm::json::Value(std::move(record)) << "\n";
+    }
+
+    void Finish() override {
+        os_.flush();
+    }
+
+private:
+    llvm::raw_ostream& os_;  // NOLINT
+    std::string file_name_;  // NOLINT
+};
+
+// SARIF 2.1.0 with one run, the results are written while the run goes on and the
+// enclosing objects are closed by Finish.
+class SarifReporter : public Reporter {
+public:
+    explicit SarifReporter(llvm::raw_ostream& os = llvm::outs()) : os_(os), json_(os) {
+        json_.objectBegin();
+        json_.attribute("version", "2.1.0");
+        json_.attribute("$schema", "https://json.schemastore.org/sarif-2.1.0.json");
+        json_.attributeBegin("runs");
+        json_.arrayBegin();
+        json_.objectBegin();
+        json_.attribute(
+            "tool",
+            llvm::json::Object{
+                {"driver",
+                 llvm::json::Object{
+                     {"name", "check_names"},
+                     {"rules", llvm::json::Array{Rule("bad-name", "Name does not meet the "
+                                                                  "naming requirements"),
+                                                 Rule("typo", "Probable typo in a name")}}}}});
+        json_.attributeBegin("results");
+        json_.arrayBegin();
+    }
+
+    void BeginFile(const std::string&, int, int) override {
+    }
+
+    void Report(const BadNames& item) override {
+        std::string text;
+        llvm::raw_string_ostream message(text);
+        if (item.bad_mistake) {
+            message << "Entity's name \"" << item.name << "\" does not meet the requirements ("
+                    << Str(item.entity) << ")";
+        } else {
+            message << "Probably mistake in variable's \"" << item.name
+                    << "\" name. Consider using \"" << item.good_name << "\" instead of \""
+                    << item.wrong_name << "\"";
+        }
+        message.flush();
+        std::string uri = item.file_name.str();
+        if (!uri.empty() && uri.front() == '/') {
+            uri = "file://" + uri;
+        }
+        json_.value(llvm::json::Object{
+            {"ruleId", item.bad_mistake ? "bad-name" : "typo"},
+            {"level", "warning"},
+            {"message", llvm::json::Object{{"text", text}}},
+            {"locations",
+             llvm::json::Array{llvm::json::Object{
+                 {"physicalLocation",
+                  llvm::json::Object{
+                      {"artifactLocation", llvm::json::Object{{"uri", uri}}},
+                      {"region", llvm::json::Object{{"startLine", item.number}}}}}}}}});
+    }
+
+    void Finish() override {
+        json_.arrayEnd();
+        json_.attributeEnd();
+        json_.objectEnd();
+        json_.arrayEnd();
+        json_.attributeEnd();
+        json_.objectEnd();
+        os_ << "\n";
+        os_.flush();
+    }
+
+private:
+    static llvm::json::Object Rule(const char* id, const char* description) {
+        return llvm::json::Object{
+            {"id", id}, {"shortDescription", llvm::json::Object{{"text", description}}}};
+    }
+
+    llvm::raw_ostream& os_;     // NOLINT
+    llvm::json::OStream json_;  // NOLINT
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+// Bump whenever the checks or the report format change, old entries are then
+// never hit again and age out of the cache.
+constexpr int kResultCacheVersion = 3;
+
+inline std::string HashOfFile(const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return "";
+    }
+    return llvm::utohexstr(llvm::xxHash64((*buffer)->getBuffer()));
+}
+
+// Per-unit results kept on disk between runs, one JSON file per unit. An entry is
+// found by a hash of the run configuration (tool version, dictionary, engine),
+// the compile command and the main file, and it is only used if every non-system
+// file the unit read last time still has the same contents. When the directory
+// grows past the size limit, the least recently used entries are removed.
+class ResultCache {
+public:
+    ResultCache(std::string dir, uint64_t max_bytes, std::string config)
+        : dir_(std::move(dir)), max_bytes_(max_bytes), config_(std::move(config)) {
+        std::error_code error;
+        std::filesystem::create_directories(dir_, error);
+    }
+
+    // The key of a unit: the configuration, the compile command and the main file.
+    std::string Key(std::string_view command, std::string_view file) const {
+        std::string key = config_;
+        key.append("\n").append(command).append("\n").append(file);
+        return key;
+    }
+
+    // The stored result of the unit, if nothing it depends on has changed.
+    std::optional<llvm::json::Value> Load(const std::string& key) {
+        auto path = EntryPath(key);
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        bytes_read_.fetch_add((*buffer)->getBufferSize(), std::memory_order_relaxed);
+        auto entry = llvm::json::parse((*buffer)->getBuffer());
+        if (!entry) {
+            llvm::consumeError(entry.takeError());
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        auto* object = entry->getAsObject();
+        if (!object || object->getString("key") != llvm::StringRef(key) || !IsFresh(*object)) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        auto* result = object->get("result");
+        if (!result) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        // The modification time is the last use for the eviction.
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(),
+                                         error);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return std::move(*result);
+    }
+
+    // Relative dependencies are taken relative to directory, the one of the compile command.
+    void Store(const std::string& key, const std::vector<std::string>& dependencies,
+               const std::string& directory, llvm::json::Value result) {
+        llvm::json::Array files;
+        for (const auto& dependency : dependencies) {
+            llvm::SmallString<256> path;
+            if (llvm::sys::path::is_relative(dependency)) {
+                path = directory;
+            }
+            llvm::sys::path::append(path, dependency);
+            auto hash = HashOfFile(std::string(path));
+            if (hash.empty()) {
+                return;
+            }
+            files.push_back(llvm::json::Array{std::string(path), hash});
+        }
+        llvm::json::Object entry{
+            {"key", key}, {"dependencies", std::move(files)}, {"result", std::move(result)}};
+        std::string text;
+        llvm::raw_string_ostream os(text);
+        os << llvm::json::Value(std::move(entry));
+        os.flush();
+        auto model = dir_ + "/%%%%%%%%%%%%.tmp";
+        if (auto error = llvm::writeFileAtomically(model, EntryPath(key), text)) {
+            llvm::consumeError(std::move(error));
+            return;
+        }
+        bytes_written_.fetch_add(text.size(), std::memory_order_relaxed);
+    }
+
+    // Removes the least recently used entries until the cache fits into the limit.
+    void Evict() {
+        struct Entry {
+            std::filesystem::path path;
+            std::filesystem::file_time_type time;
+            uint64_t size;
+        };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        std::error_code error;
+        for (const auto& file : std::filesystem::directory_iterator(dir_, error)) {
+            if (file.path().extension() != ".json") {
+                continue;
+            }
+            std::error_code file_error;
+            auto size = file.file_size(file_error);
+            auto time = file.last_write_time(file_error);
+            if (!file_error) {
+                entries.push_back({file.path(), time, size});
+                total += size;
+            }
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& lhs, const Entry& rhs) { return lhs.time < rhs.time; });
+        for (const auto& entry : entries) {
+            if (total <= max_bytes_) {
+                break;
+            }
+            if (std::filesystem::remove(entry.path, error)) {
+                total -= entry.size;
+                ++evicted_;
+            }
+        }
+        size_ = total;
+    }
+
+    void PrintStats(llvm::raw_ostream& os = llvm::errs()) const {
+        os << "Result cache: " << dir_ << "\n";
+        os << "Hits: " << hits_.load() << ", misses: " << misses_.load() << "\n";
+        os << "Read: " << bytes_read_.load() << " bytes, written: " << bytes_written_.load()
+           << " bytes\n";
+        os << "Size: " << size_ << " bytes, evicted entries: " << evicted_ << "\n";
+    }
+
+private:
+    std::string EntryPath(const std::string& key) const {
+        return dir_ + "/" + llvm::utohexstr(llvm::xxHash64(key)) + ".json";
+    }
+
+    static bool IsFresh(const llvm::json::Object& entry) {
+        auto* files = entry.getArray("dependencies");
+        if (!files) {
+            return false;
+        }
+        for (const auto& file : *files) {
+            auto* pair = file.getAsArray();
+            if (!pair || pair->size() != 2) {
+                return false;
+            }
+            auto path = (*pair)[0].getAsString();
+            auto hash = (*pair)[1].getAsString();
+            if (!path || !hash || HashOfFile(path->str()) != *hash) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string dir_;
+    uint64_t max_bytes_;
+    std::string config_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> bytes_read_ = 0;
+    std::atomic<uint64_t> bytes_written_ = 0;
+    uint64_t evicted_ = 0;
+    uint64_t size_ = 0;
+};
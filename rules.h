@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdexcept>
+#include <string_view>
+#include "print.h"
+
+// Single-pass scanners for the naming rules. Each one accepts exactly the same
+// names as the regex it replaces, but never allocates and never backtracks.
+
+inline bool IsLower(char c) {
+    return c >= 'a' && c <= 'z';
+}
+
+inline bool IsUpper(char c) {
+    return c >= 'A' && c <= 'Z';
+}
+
+// [a-z]+(_[a-z]+)*
+inline bool IsVariableName(std::string_view name) {
+    if (name.empty() || !IsLower(name.front()) || !IsLower(name.back())) {
+        return false;
+    }
+    char prev = '\0';
+    for (char c : name) {
+        if (c == '_') {
+            if (prev == '_') {
+                return false;
+            }
+        } else if (!IsLower(c)) {
+            return false;
+        }
+        prev = c;
+    }
+    return true;
+}
+
+// ([a-z]+\_[a-z]+\_)|([a-z]+\_)
+inline bool IsFieldName(std::string_view name) {
+    if (name.size() < 2 || name.back() != '_') {
+        return false;
+    }
+    int words = 0;
+    size_t len = 0;
+    for (char c : name) {
+        if (c == '_') {
+            if (len == 0) {
+                return false;
+            }
+            ++words;
+            len = 0;
+        } else if (IsLower(c)) {
+            ++len;
+        } else {
+            return false;
+        }
+    }
+    return words <= 2;
+}
+
+// k([A-Z]{1,}[a-z]+)+
+inline bool IsConstName(std::string_view name) {
+    if (name.size() < 3 || name.front() != 'k' || !IsUpper(name[1]) || !IsLower(name.back())) {
+        return false;
+    }
+    for (size_t i = 1; i < name.size(); ++i) {
+        if (!IsUpper(name[i]) && !IsLower(name[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$
+// Every run of capitals followed by a lowercase run must have length 1 or at
+// least 4 (an abbreviation of 3+ letters plus the start of the next word); a
+// trailing run of capitals must have length at least 3.
+inline bool IsCamelCaseName(std::string_view name) {
+    if (name.empty() || !IsUpper(name.front())) {
+        return false;
+    }
+    size_t upper = 0;
+    bool has_lower = false;
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        if (IsUpper(c)) {
+            ++upper;
+        } else if (IsLower(c)) {
+            if (upper == 2 || upper == 3) {
+                return false;
+            }
+            upper = 0;
+            has_lower = true;
+        } else {
+            return false;
+        }
+    }
+    return has_lower && (upper == 0 || upper >= 3);
+}
+
+inline bool MatchesNamingRule(Entity entity, std::string_view name) {
+    switch (entity) {
+        case Entity::kVariable:
+            return IsVariableName(name);
+        case Entity::kField:
+            return IsFieldName(name);
+        case Entity::kConst:
+            return IsConstName(name);
+        case Entity::kType:
+        case Entity::kFunction:
+            return IsCamelCaseName(name);
+        default:
+            throw std::runtime_error{"Bad entity"};
+    }
+}
@@ -0,0 +1,73 @@
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "rules.h"
+
+// The scanners of rules.h against the regexes of the naming rules they replace:
+// boundary cases first, then random names over an alphabet that hits every branch
+// of the scanners. Exits with 1 on the first names they disagree on.
+
+struct Rule {
+    Entity entity;
+    std::regex regex;
+};
+
+std::vector<Rule> BaselineRules() {
+    return {
+        {Entity::kVariable, std::regex(R"([a-z]+(_[a-z]+)*)")},
+        {Entity::kField, std::regex(R"(([a-z]+\_[a-z]+\_)|([a-z]+\_))")},
+        {Entity::kConst, std::regex(R"(k([A-Z]{1,}[a-z]+)+)")},
+        {Entity::kType, std::regex(R"(^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$)")},
+        {Entity::kFunction, std::regex(R"(^(([A-Z]{3,})?[A-Z][a-z]+)+([A-Z]{3,})?$)")},
+    };
+}
+
+int mismatches = 0;
+
+void Check(const std::vector<Rule>& rules, const std::string& name) {
+    for (const auto& rule : rules) {
+        bool expected = std::regex_match(name, rule.regex);
+        if (MatchesNamingRule(rule.entity, name) != expected) {
+            llvm::errs() << Str(rule.entity) << " \"" << name << "\": the regex "
+                         << (expected ? "accepts" : "rejects") << " it, the scanner does not\n";
+            ++mismatches;
+        }
+    }
+}
+
+int main(int argc, const char** argv) {
+    llvm::cl::opt<unsigned> names{"names", llvm::cl::desc("Number of random names"),
+                                  llvm::cl::init(200000)};
+    llvm::cl::opt<unsigned> seed{"seed", llvm::cl::desc("Seed of the generator"),
+                                 llvm::cl::init(1)};
+    llvm::cl::ParseCommandLineOptions(argc, argv, "naming rule scanner tests\n");
+
+    auto rules = BaselineRules();
+    for (const char* name :
+         {"", "_", "__", "a", "A", "k", "K", "z", "Z", "0", "a_", "_a", "a__", "a_b", "a_b_",
+          "a_b_c_", "_a_", "a__b", "ab_", "a1", "a1_", "1a", "kA", "kAa", "kAb1", "kABc", "kaB",
+          "k_Ab", "Ab", "AB", "ABC", "AbC", "AbCD", "AbCDE", "ABc", "ABCd", "ABCDe", "AbABC",
+          "Ab_Cd", "Ab1", "A1b", "HTTPServer", "HttpServer", "GetURL", "GetUrl", "IOError"}) {
+        Check(rules, name);
+    }
+    // Letters on both sides of the case and class boundaries, digits and symbols.
+    static constexpr std::string_view kAlphabet = "abkzABKZ_09$";
+    std::mt19937 rng(seed);
+    for (unsigned i = 0; i < names && mismatches < 10; ++i) {
+        std::string name(rng() % 13, ' ');
+        for (auto& c : name) {
+            c = kAlphabet[rng() % kAlphabet.size()];
+        }
+        Check(rules, name);
+    }
+    if (mismatches > 0) {
+        return 1;
+    }
+    llvm::outs() << "Naming rules: no differences from the regexes\n";
+    return 0;
+}
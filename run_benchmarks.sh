@@ -0,0 +1,250 @@
+#!/bin/bash
+
+set -e
+
+S=$1
+N=${2:-$(nproc)}
+
+# Results of an earlier run to compare with, see compare_benchmarks.sh.
+BASELINE=$BENCHMARK_BASELINE
+
+FILES="$S/tests/no-dict/*.cpp $S/tests/dict/*.cpp $S/check_names.cpp"
+
+# Every measurement is one line "<name> <metric>=<value> ...", printed and kept in
+# benchmark_results.txt. compare_benchmarks.sh matches the lines of two such files
+# by their first field.
+RESULTS=benchmark_results.txt
+: > $RESULTS
+result() {
+    echo "$@" | tee -a $RESULTS
+}
+
+# Prints the wall time of a check_names run in milliseconds, the report goes to $1.
+measure() {
+    local out=$1
+    shift
+    local start=$(date +%s%N)
+    ./check_names "$@" > $out 2> /dev/null
+    local end=$(date +%s%N)
+    echo $(( (end - start) / 1000000 ))
+}
+
+echo "== Scaling over translation units"
+for j in $(seq 1 $N); do
+    ms=$(measure /tmp/bench-j$j.txt -p . $FILES -dict $S/tests/dict/dict.txt -j $j)
+    result "threads=$j time_ms=$ms"
+    diff -q /tmp/bench-j1.txt /tmp/bench-j$j.txt
+done
+
+echo "== Traversal engines on heavy headers"
+HEAVY=/tmp/bench-heavy.cpp
+cat > $HEAVY <<'CPP'
+#include <iostream>
+#include <regex>
+
+class BadClass_name {
+public:
+    int GoodField;
+};
+
+int main() {
+    std::regex pattern("[a-z]+");
+    std::cout << std::regex_match("name", pattern) << '\n';
+}
+CPP
+for engine in matcher visitor; do
+    ms=$(measure /tmp/bench-$engine.txt $HEAVY -engine $engine -- -std=c++17)
+    result "engine=$engine time_ms=$ms"
+done
+diff -q /tmp/bench-matcher.txt /tmp/bench-visitor.txt
+
+echo "== Headers shared by many units"
+SHARED=/tmp/bench-shared
+rm -rf $SHARED
+mkdir -p $SHARED
+for i in $(seq 1 200); do
+    echo "int bad_Name$i(int Argument_$i);" >> $SHARED/common.h
+done
+for i in $(seq 1 50); do
+    printf '#include "common.h"\n\nint unit_%d() {\n    return 0;\n}\n' $i > $SHARED/unit$i.cpp
+done
+for mode in each once; do
+    ms=$(measure /tmp/bench-shared-$mode.txt $SHARED/unit*.cpp -header-report $mode -- -I$SHARED)
+    result "header_report=$mode time_ms=$ms lines=$(wc -l < /tmp/bench-shared-$mode.txt)"
+done
+
+echo "== Result cache"
+rm -rf /tmp/bench-cache
+for run in cold warm; do
+    ms=$(measure /tmp/bench-cache-$run.txt -p . $FILES -dict $S/tests/dict/dict.txt \
+        -cache-dir /tmp/bench-cache)
+    result "cache=$run time_ms=$ms"
+done
+diff -q /tmp/bench-j1.txt /tmp/bench-cache-warm.txt
+
+echo "== Shared preamble"
+for mode in cold preamble; do
+    flags=""
+    if [ $mode = preamble ]; then
+        flags="-shared-preamble"
+    fi
+    ms=$(measure /tmp/bench-preamble-$mode.txt -p . $FILES -dict $S/tests/dict/dict.txt $flags)
+    result "parse=$mode time_ms=$ms"
+done
+diff -q /tmp/bench-preamble-cold.txt /tmp/bench-preamble-preamble.txt
+
+echo "== Declarations only"
+full_ms=$(measure /tmp/bench-full.txt -p . $FILES)
+decls_ms=$(measure /tmp/bench-decls.txt -p . $FILES -decls-only)
+result "full time_ms=$full_ms findings=$(grep -c '^Entity' /tmp/bench-full.txt || true)"
+result "decls-only time_ms=$decls_ms findings=$(grep -c '^Entity' /tmp/bench-decls.txt || true)"
+result "decls-saved time_ms=$((full_ms - decls_ms))"
+
+echo "== Memory of many findings"
+MANY=/tmp/bench-many.cpp
+rm -f $MANY
+for i in $(seq 1 20000); do
+    echo "int bad_Name$i, Wrong_Value$i;" >> $MANY
+done
+if [ -x /usr/bin/time ]; then
+    /usr/bin/time -f "%M" -o /tmp/bench-many-rss.txt ./check_names $MANY -- \
+        > /tmp/bench-many.txt 2> /dev/null
+    result "many-findings findings=$(grep -c '^Entity' /tmp/bench-many.txt || true)" \
+        "peak_rss_kb=$(cat /tmp/bench-many-rss.txt)"
+fi
+if command -v valgrind > /dev/null; then
+    valgrind ./check_names $MANY -- 2>&1 > /dev/null | grep "total heap usage" |
+        sed 's/^==[0-9]*== *//'
+fi
+
+echo "== Compiled dictionary"
+./check_names --compile-dict $S/tests/dict/dict.txt /tmp/bench-dict.idx 2> /dev/null
+for kind in text compiled; do
+    path=$S/tests/dict/dict.txt
+    if [ $kind = compiled ]; then
+        path=/tmp/bench-dict.idx
+    fi
+    ms=$(measure /tmp/bench-dict-$kind.txt -p . $S/tests/dict/*.cpp -dict $path)
+    result "dict=$kind time_ms=$ms"
+done
+diff -q /tmp/bench-dict-text.txt /tmp/bench-dict-compiled.txt
+
+echo "== Resident server"
+# The socket exists before the server has checked the start files, the first
+# request waits for that and is not measured.
+SOCKET=/tmp/bench-serve.sock
+ms=$(measure /tmp/bench-serve-cold.txt $HEAVY -- -std=c++17)
+result "serve=cold time_ms=$ms"
+./check_names -serve $SOCKET $HEAVY -- -std=c++17 2> /dev/null &
+SERVER=$!
+while [ ! -S $SOCKET ]; do
+    sleep 0.1
+done
+./check_names_client -socket $SOCKET $HEAVY > /dev/null
+start=$(date +%s%N)
+./check_names_client -socket $SOCKET $HEAVY > /tmp/bench-serve-warm.txt
+end=$(date +%s%N)
+result "serve=request time_ms=$(( (end - start) / 1000000 ))"
+./check_names_client -socket $SOCKET -shutdown
+wait $SERVER
+diff -q /tmp/bench-serve-cold.txt /tmp/bench-serve-warm.txt
+
+echo "== Synthetic corpus"
+# The size of the corpus can be changed through the environment, a baseline is
+# only comparable with results for the same sizes.
+CORPUS=/tmp/bench-corpus
+CORPUS_FLAGS="-units ${BENCH_UNITS:-50} -decls ${BENCH_DECLS:-200}
+    -bad-ratio ${BENCH_BAD_RATIO:-0.1} -typo-ratio ${BENCH_TYPO_RATIO:-0.05}
+    -words ${BENCH_WORDS:-zipf} -dict-size ${BENCH_DICT_SIZE:-20000}"
+rm -rf $CORPUS
+./bench_check_names -generate $CORPUS $CORPUS_FLAGS
+./check_names --compile-dict $CORPUS/dict.txt $CORPUS/dict.idx 2> /dev/null
+ms=$(measure /tmp/bench-corpus-nodict.txt $CORPUS/*.cpp --)
+result "corpus-nodict time_ms=$ms findings=$(grep -c '^Entity' /tmp/bench-corpus-nodict.txt || true)"
+for j in 1 $N; do
+    ms=$(measure /tmp/bench-corpus-j$j.txt $CORPUS/*.cpp -dict $CORPUS/dict.txt -j $j --)
+    result "corpus-j$j time_ms=$ms"
+done
+diff -q /tmp/bench-corpus-j1.txt /tmp/bench-corpus-j$N.txt
+ms=$(measure /tmp/bench-corpus-compiled.txt $CORPUS/*.cpp -dict $CORPUS/dict.idx -j $N --)
+result "corpus-compiled-dict time_ms=$ms"
+
+echo "== Scheduling"
+# The heavy unit comes last in the list, the first run records the unit costs.
+COSTS=/tmp/bench-unit-costs
+rm -f $COSTS
+./check_names $CORPUS/*.cpp $HEAVY -j $N -cost-file $COSTS -- -std=c++17 > /dev/null 2>&1
+for order in sources largest-first; do
+    ms=$(measure /tmp/bench-schedule-$order.txt $CORPUS/*.cpp $HEAVY -j $N -cost-file $COSTS \
+        -schedule $order -- -std=c++17)
+    result "schedule=$order time_ms=$ms"
+done
+diff -q /tmp/bench-schedule-sources.txt /tmp/bench-schedule-largest-first.txt
+ms=$(measure /tmp/bench-schedule-budget.txt $CORPUS/*.cpp $HEAVY -j $N -cost-file $COSTS \
+    -memory-budget 256 -- -std=c++17)
+result "schedule=budget-256mb time_ms=$ms"
+
+echo "== Diff of one unit"
+# A diff adding the first lines of one unit, the other units are not parsed.
+DIFF=/tmp/bench-corpus.diff
+UNIT=$(realpath --relative-to=. $CORPUS/unit_0.cpp)
+printf -- '--- a/%s\n+++ b/%s\n@@ -1,0 +1,3 @@\n+\n+\n+\n' $UNIT $UNIT > $DIFF
+ms=$(measure /tmp/bench-corpus-diff.txt $CORPUS/*.cpp -dict $CORPUS/dict.txt -diff $DIFF --)
+result "corpus-diff time_ms=$ms findings=$(grep -c '^Entity' /tmp/bench-corpus-diff.txt || true)"
+
+echo "== Header filter"
+# A unit including a large vendored header through -I, with and without it excluded.
+VENDOR=/tmp/bench-vendor
+rm -rf $VENDOR
+mkdir -p $VENDOR/third_party
+# The units reuse names, each one gets its own namespace.
+i=0
+for unit in $CORPUS/unit_*.cpp; do
+    echo "namespace part_$i {"
+    cat $unit
+    echo "}"
+    i=$((i + 1))
+done > $VENDOR/third_party/vendored.h
+printf '#include "vendored.h"\nint main_value = 0;\n' > $VENDOR/main.cpp
+for engine in visitor matcher; do
+    for filter in none exclude; do
+        args=""
+        [ $filter = exclude ] && args="-exclude /third_party/"
+        out=/tmp/bench-filter-$engine-$filter.txt
+        ms=$(measure $out $VENDOR/main.cpp $args -dict $CORPUS/dict.txt -engine $engine \
+            -- -I$VENDOR/third_party)
+        result "header-filter=$filter/$engine time_ms=$ms findings=$(grep -c '^Entity' $out \
+            || true)"
+    done
+done
+
+echo "== Lexer engine"
+# The lexer engine against the AST on the same units: its time and how its findings
+# differ, those it misses (only_ast) and those it reports wrongly (only_lexer).
+compare_engines() {
+    local name=$1
+    shift
+    for engine in matcher lexer; do
+        ms=$(measure /tmp/bench-lexer-$name-$engine.txt "$@" -engine $engine)
+        grep '^Entity' /tmp/bench-lexer-$name-$engine.txt | sort \
+            > /tmp/bench-lexer-$name-$engine.sorted || true
+        eval "${engine}_ms=$ms"
+    done
+    local a=/tmp/bench-lexer-$name-matcher.sorted
+    local b=/tmp/bench-lexer-$name-lexer.sorted
+    result "lexer=$name time_ms=$lexer_ms ast_time_ms=$matcher_ms" \
+        "only_ast=$(comm -23 $a $b | wc -l) only_lexer=$(comm -13 $a $b | wc -l)"
+    # The differing findings themselves, not kept in the results.
+    comm -23 $a $b | sed 's/^/  only_ast: /'
+    comm -13 $a $b | sed 's/^/  only_lexer: /'
+}
+compare_engines tests -p . $FILES -dict $S/tests/dict/dict.txt
+compare_engines corpus $CORPUS/*.cpp -dict $CORPUS/dict.txt -j $N --
+
+echo "== Microbenchmarks"
+./bench_check_names $CORPUS_FLAGS | tee -a $RESULTS
+
+if [ -n "$BASELINE" ]; then
+    echo "== Against $BASELINE"
+    $S/compare_benchmarks.sh $BASELINE $RESULTS
+fi
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <llvm/Support/Format.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include "dict_index.h"
+#include "print.h"
+
+// The declaration checks, one per matcher callback (and visitor method).
+enum class CheckKind { kVar, kField, kFunction, kRecord, kEnum, kTypeAlias, kTypeDef };
+
+constexpr size_t kCheckKinds = 7;
+
+inline std::string CallbackName(CheckKind kind) {
+    switch (kind) {
+        case CheckKind::kVar:
+            return "CallbackForVarDecl";
+        case CheckKind::kField:
+            return "CallbackForFieldDecl";
+        case CheckKind::kFunction:
+            return "CallbackForFunctionDecl";
+        case CheckKind::kRecord:
+            return "CallbackForRecordDecl";
+        case CheckKind::kEnum:
+            return "CallbackForEnumDecl";
+        case CheckKind::kTypeAlias:
+            return "CallbackForTypeAliasDecl";
+        case CheckKind::kTypeDef:
+            return "CallbackForTypeDefDecl";
+        default:
+            throw std::runtime_error{"Bad check kind"};
+    }
+}
+
+// Where the time of a run goes, for -run-stats: the parse and the traversal of every
+// unit, the calls and the time of every check, the declarations rejected as system
+// ones and the findings per entity. When disabled, every hook costs one branch on
+// a plain bool, which the callers test before taking any time.
+class RunStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void Enable() {
+        enabled_ = true;
+        start_ = Clock::now();
+    }
+
+    bool Enabled() const {
+        return enabled_;
+    }
+
+    // The unit was parsed from parse_start to match_start and traversed until match_end.
+    void AddUnit(std::string file, Clock::time_point parse_start, Clock::time_point match_start,
+                 Clock::time_point match_end) {
+        std::lock_guard lock(mutex_);
+        units_.push_back(
+            {std::move(file), llvm::get_threadid(), parse_start, match_start, match_end});
+    }
+
+    void AddCheck(CheckKind kind, Clock::duration spent) {
+        auto& counter = checks_[static_cast<size_t>(kind)];
+        counter.calls.fetch_add(1, std::memory_order_relaxed);
+        counter.ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count(),
+                             std::memory_order_relaxed);
+    }
+
+    void AddSystemRejection() {
+        rejections_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void AddFilterRejection() {
+        filtered_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The wall time of a run of units and its makespan simulated with the unit times
+    // of the run, in the order of the sources and in the order the units were started.
+    void AddSchedule(double wall_ms, double source_order_ms, double run_order_ms) {
+        std::lock_guard lock(mutex_);
+        schedule_.wall += wall_ms;
+        schedule_.source_order += source_order_ms;
+        schedule_.run_order += run_order_ms;
+    }
+
+    // Called for every reported finding, from one thread at a time.
+    void AddFinding(Entity entity, bool bad_name) {
+        ++(bad_name ? findings_[static_cast<size_t>(entity)] : typos_);
+    }
+
+    void Print(const DictIndex& index, llvm::raw_ostream& os = llvm::errs()) {
+        std::lock_guard lock(mutex_);
+        std::sort(units_.begin(), units_.end(),
+                  [](const UnitTiming& lhs, const UnitTiming& rhs) { return lhs.file < rhs.file; });
+        double parse_total = 0;
+        double match_total = 0;
+        os << "===== Run statistics =====\n";
+        os << llvm::left_justify("Unit", 40) << llvm::right_justify("Parse ms", 12)
+           << llvm::right_justify("Match ms", 12) << "\n";
+        for (const auto& unit : units_) {
+            double parse = Milliseconds(unit.match_start - unit.parse_start);
+            double match = Milliseconds(unit.match_end - unit.match_start);
+            parse_total += parse;
+            match_total += match;
+            os << llvm::left_justify(llvm::sys::path::filename(unit.file), 40)
+               << llvm::format("%12.1f%12.1f\n", parse, match);
+        }
+        os << llvm::left_justify("Total (" + std::to_string(units_.size()) + " units)", 40)
+           << llvm::format("%12.1f%12.1f\n\n", parse_total, match_total);
+        os << llvm::left_justify("Callback", 40) << llvm::right_justify("Calls", 12)
+           << llvm::right_justify("Time ms", 12) << "\n";
+        for (size_t i = 0; i < kCheckKinds; ++i) {
+            os << llvm::left_justify(CallbackName(static_cast<CheckKind>(i)), 40)
+               << llvm::format("%12llu%12.1f\n",
+                               static_cast<unsigned long long>(checks_[i].calls.load()),
+                               static_cast<double>(checks_[i].ns.load()) / 1e6);
+        }
+        os << "\nSystem header rejections: " << rejections_.load() << "\n";
+        os << "Header filter rejections: " << filtered_.load() << "\n";
+        os << "Dictionary queries: " << index.Queries()
+           << ", comparisons: " << index.Comparisons()
+           << llvm::format(", time: %.1f ms\n", static_cast<double>(index.QueryTime()) / 1e6);
+        os << "Findings:";
+        for (auto entity : {Entity::kVariable, Entity::kField, Entity::kType, Entity::kConst,
+                            Entity::kFunction}) {
+            os << " " << Str(entity) << " " << findings_[static_cast<size_t>(entity)] << ",";
+        }
+        os << " typo " << typos_ << "\n";
+        os << llvm::format("Schedule: %.1f ms, simulated in the order of the sources: %.1f ms, in "
+                           "the order of the run: %.1f ms\n",
+                           schedule_.wall, schedule_.source_order, schedule_.run_order);
+        os << llvm::format("Wall time: %.1f ms\n", Milliseconds(Clock::now() - start_));
+    }
+
+    // Chrome trace events (chrome://tracing, Perfetto): a parse and a match span per
+    // unit on the thread that ran it.
+    bool WriteTrace(const std::string& path) {
+        std::error_code error;
+        llvm::raw_fd_ostream os(path, error);
+        if (error) {
+            llvm::errs() << path << ": " << error.message() << "\n";
+            return false;
+        }
+        std::lock_guard lock(mutex_);
+        llvm::json::OStream json(os);
+        json.object([&] {
+            json.attributeArray("traceEvents", [&] {
+                for (const auto& unit : units_) {
+                    auto name = llvm::sys::path::filename(unit.file);
+                    json.value(Span("parse " + name.str(), unit.thread, unit.parse_start,
+                                    unit.match_start));
+                    json.value(Span("match " + name.str(), unit.thread, unit.match_start,
+                                    unit.match_end));
+                }
+            });
+            json.attribute("displayTimeUnit", "ms");
+        });
+        os << "\n";
+        return true;
+    }
+
+private:
+    struct UnitTiming {
+        std::string file;
+        uint64_t thread;
+        Clock::time_point parse_start;
+        Clock::time_point match_start;
+        Clock::time_point match_end;
+    };
+
+    struct Schedule {
+        double wall = 0;
+        double source_order = 0;
+        double run_order = 0;
+    };
+
+    struct CheckCounter {
+        std::atomic<uint64_t> calls = 0;
+        std::atomic<uint64_t> ns = 0;
+    };
+
+    static double Milliseconds(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    llvm::json::Object Span(std::string name, uint64_t thread, Clock::time_point begin,
+                            Clock::time_point end) const {
+        auto micros = [](Clock::duration duration) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        };
+        return llvm::json::Object{{"name", std::move(name)},
+                                  {"ph", "X"},
+                                  {"pid", 1},
+                                  {"tid", static_cast<int64_t>(thread)},
+                                  {"ts", micros(begin - start_)},
+                                  {"dur", micros(end - begin)}};
+    }
+
+    bool enabled_ = false;
+    Clock::time_point start_;
+    std::mutex mutex_;
+    std::vector<UnitTiming> units_;
+    Schedule schedule_;
+    std::array<CheckCounter, kCheckKinds> checks_;
+    std::atomic<uint64_t> rejections_ = 0;
+    std::atomic<uint64_t> filtered_ = 0;
+    std::array<uint64_t, 5> findings_ = {};
+    uint64_t typos_ = 0;
+};
@@ -5,8 +5,26 @@ set -e
 S=$1
 Q=$2
 
+# The naming rule scanners against the regexes they replace, the declarations of the
+# lexer engine in token sequences.
+./rules_test > /dev/null
+./lexer_scan_test > /dev/null
+
 ./check_names -p . $S/tests/no-dict/*.cpp $S/check_names.cpp > /tmp/no-dict-result.txt 2> /dev/null
 ./check_names -p . $S/tests/dict/*.cpp -dict $S/tests/dict/dict.txt > /tmp/dict-result.txt 2> /dev/null
 
 diff $S/tests/no-dict/result.txt /tmp/no-dict-result.txt $Q
 diff $S/tests/dict/result.txt /tmp/dict-result.txt $Q
+
+# The same run split into three shards, checked by separate processes and merged.
+pids=""
+for i in 0 1 2; do
+    ./check_names -p . $S/tests/dict/*.cpp -dict $S/tests/dict/dict.txt -shard $i/3 \
+        -shard-output /tmp/dict-shard$i.json 2> /dev/null &
+    pids="$pids $!"
+done
+for pid in $pids; do
+    wait $pid
+done
+./check_names --merge -dict $S/tests/dict/dict.txt /tmp/dict-shard*.json > /tmp/dict-merged.txt
+diff $S/tests/dict/result.txt /tmp/dict-merged.txt $Q
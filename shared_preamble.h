@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+// The headers of the #include <...> lines a file starts with. Only blank lines and
+// line comments may come between them, the first other line ends the list.
+inline std::vector<std::string> LeadingSystemIncludes(const std::string& path) {
+    std::vector<std::string> headers;
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return headers;
+    }
+    llvm::StringRef text = (*buffer)->getBuffer();
+    while (!text.empty()) {
+        llvm::StringRef line;
+        std::tie(line, text) = text.split('\n');
+        line = line.trim();
+        if (line.empty() || line.startswith("//")) {
+            continue;
+        }
+        if (!line.consume_front("#")) {
+            break;
+        }
+        line = line.ltrim();
+        if (!line.consume_front("include")) {
+            break;
+        }
+        line = line.ltrim();
+        if (!line.consume_front("<") || !line.contains('>')) {
+            break;
+        }
+        headers.push_back(line.substr(0, line.find('>')).str());
+    }
+    return headers;
+}
+
+// The compile command of a file without its output and the file itself. Units with
+// equal flags can share a PCH.
+inline std::vector<std::string> CommandFlags(const clang::tooling::CompileCommand& command) {
+    auto args =
+        clang::tooling::getClangStripOutputAdjuster()(command.CommandLine, command.Filename);
+    args.erase(std::remove(args.begin(), args.end(), command.Filename), args.end());
+    return args;
+}
+
+// Writes the PCH into the given file instead of the one of the command line.
+class PCHOutputAction : public clang::GeneratePCHAction {
+public:
+    explicit PCHOutputAction(std::string output) : output_(std::move(output)) {
+    }
+
+protected:
+    bool BeginInvocation(clang::CompilerInstance& compiler) override {
+        compiler.getFrontendOpts().OutputFile = output_;
+        return clang::GeneratePCHAction::BeginInvocation(compiler);
+    }
+
+private:
+    std::string output_;  // NOLINT
+};
+
+// A PCH of the system headers many units start with. Only the units with the same
+// flags whose leading #include <...> lines begin with exactly these headers use it,
+// for them -include-pch is equivalent to those first lines, so the AST of the
+// project code does not change. Among all (flags, prefix of the leading includes)
+// pairs the one with the largest number of units times headers is taken.
+class SharedPreamble {
+public:
+    // Returns nullptr if no prefix is shared by min_units units or the PCH does not build.
+    static std::unique_ptr<SharedPreamble> Build(
+        const clang::tooling::CompilationDatabase& compilations,
+        const std::vector<std::string>& files, size_t min_units = 2) {
+        std::map<std::pair<std::vector<std::string>, std::vector<std::string>>, size_t> counts;
+        std::map<std::vector<std::string>, clang::tooling::CompileCommand> commands;
+        for (const auto& file : files) {
+            auto file_commands = compilations.getCompileCommands(file);
+            if (file_commands.size() != 1) {
+                continue;
+            }
+            auto flags = CommandFlags(file_commands.front());
+            auto headers = LeadingSystemIncludes(file);
+            for (size_t len = 1; len <= headers.size(); ++len) {
+                std::vector<std::string> prefix(headers.begin(), headers.begin() + len);
+                ++counts[{flags, prefix}];
+            }
+            commands.emplace(flags, file_commands.front());
+        }
+        const std::pair<std::vector<std::string>, std::vector<std::string>>* best = nullptr;
+        size_t best_score = 0;
+        for (const auto& [key, count] : counts) {
+            if (count >= min_units && count * key.second.size() > best_score) {
+                best = &key;
+                best_score = count * key.second.size();
+            }
+        }
+        if (!best) {
+            return nullptr;
+        }
+        std::unique_ptr<SharedPreamble> preamble(new SharedPreamble(best->first, best->second));
+        if (!preamble->Compile(commands.at(best->first))) {
+            preamble->Remove();
+            return nullptr;
+        }
+        return preamble;
+    }
+
+    // The unit has the flags of the preamble and starts with its headers.
+    bool Fits(const clang::tooling::CompilationDatabase& compilations,
+              const std::string& file) const {
+        auto file_commands = compilations.getCompileCommands(file);
+        if (file_commands.size() != 1 || CommandFlags(file_commands.front()) != flags_) {
+            return false;
+        }
+        auto headers = LeadingSystemIncludes(file);
+        return headers.size() >= headers_.size() &&
+               std::equal(headers_.begin(), headers_.end(), headers.begin());
+    }
+
+    clang::tooling::ArgumentsAdjuster Adjuster() const {
+        return clang::tooling::getInsertArgumentAdjuster(
+            {"-include-pch", pch_path_}, clang::tooling::ArgumentInsertPosition::BEGIN);
+    }
+
+    void Remove() {
+        llvm::sys::fs::remove(header_path_);
+        llvm::sys::fs::remove(pch_path_);
+    }
+
+private:
+    SharedPreamble(std::vector<std::string> flags, std::vector<std::string> headers)
+        : flags_(std::move(flags)), headers_(std::move(headers)) {
+    }
+
+    bool Compile(const clang::tooling::CompileCommand& command) {
+        llvm::SmallString<128> header_path;
+        llvm::SmallString<128> pch_path;
+        int header_fd = 0;
+        if (llvm::sys::fs::createTemporaryFile("check_names-preamble", "h", header_fd,
+                                               header_path) ||
+            llvm::sys::fs::createTemporaryFile("check_names-preamble", "pch", pch_path)) {
+            return false;
+        }
+        header_path_ = std::string(header_path);
+        pch_path_ = std::string(pch_path);
+        {
+            llvm::raw_fd_ostream os(header_fd, true);
+            for (const auto& header : headers_) {
+                os << "#include <" << header << ">\n";
+            }
+        }
+        // The command of one of the units, with the header in place of the source file.
+        auto args = clang::tooling::getClangSyntaxOnlyAdjuster()(
+            clang::tooling::getClangStripDependencyFileAdjuster()(
+                clang::tooling::getClangStripOutputAdjuster()(command.CommandLine,
+                                                              command.Filename),
+                command.Filename),
+            command.Filename);
+        auto source = std::find(args.begin(), args.end(), command.Filename);
+        if (source == args.end()) {
+            return false;
+        }
+        *source = header_path_;
+        args.insert(source, {"-x", "c++-header"});
+        auto file_system = llvm::vfs::createPhysicalFileSystem();
+        file_system->setCurrentWorkingDirectory(command.Directory);
+        llvm::IntrusiveRefCntPtr<clang::FileManager> files(
+            new clang::FileManager(clang::FileSystemOptions(), std::move(file_system)));
+        clang::tooling::ToolInvocation invocation(
+            args, std::make_unique<PCHOutputAction>(pch_path_), files.get());
+        return invocation.run();
+    }
+
+    std::vector<std::string> flags_;    // NOLINT
+    std::vector<std::string> headers_;  // NOLINT
+    std::string header_path_;           // NOLINT
+    std::string pch_path_;              // NOLINT
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include "dict_index.h"
+#include "levenshtein.h"
+
+// Splits an identifier into words at underscores and before capital letters.
+// Only the words longer than 3 characters are checked for typos. The words are
+// views into name.
+inline std::vector<std::string_view> SplitWords(std::string_view name) {
+    std::vector<std::string_view> words;
+    size_t start = 0;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == '_') {
+            words.push_back(name.substr(start, i - start));
+            start = i + 1;
+        } else if (name[i] >= 'A' && name[i] <= 'Z' && i > start) {
+            words.push_back(name.substr(start, i - start));
+            start = i;
+        }
+    }
+    words.push_back(name.substr(start));
+    return words;
+}
+
+// Nearest-word lookups, deferred until the words of a whole report block are known.
+// Each distinct word (up to case, which the distance ignores on the identifier
+// side) is looked up once, the lookups are spread over a thread pool.
+class TypoStage {
+public:
+    explicit TypoStage(const DictIndex& index, unsigned threads = 0)
+        : index_(&index), threads_(threads) {
+    }
+
+    // Looks up every word that has not been seen before.
+    void Resolve(const std::vector<std::string_view>& words) {
+        std::vector<std::string> pending;
+        for (auto word : words) {
+            auto key = Key(word);
+            if (memo_.count(key) == 0) {
+                memo_.emplace(key, Suggestion{});
+                pending.push_back(std::move(key));
+            }
+        }
+        if (pending.empty()) {
+            return;
+        }
+        std::vector<Suggestion> results(pending.size());
+        auto run_range = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                results[i] = index_->Find(LevPattern(pending[i]));
+            }
+        };
+        // The report is resolved block by block, most batches are too small for a pool.
+        if (pending.size() < kMinPoolWords) {
+            run_range(0, pending.size());
+            Store(pending, results);
+            return;
+        }
+        llvm::ThreadPool pool(llvm::hardware_concurrency(threads_));
+        size_t tasks = std::min<size_t>(pending.size(), 4 * pool.getThreadCount());
+        for (size_t task = 0; task < tasks; ++task) {
+            pool.async(run_range, task * pending.size() / tasks,
+                       (task + 1) * pending.size() / tasks);
+        }
+        pool.wait();
+        Store(pending, results);
+    }
+
+    // The suggestion for a word passed to Resolve before.
+    const Suggestion& Lookup(std::string_view word) const {
+        return memo_.at(Key(word));
+    }
+
+    // The number of words looked up so far.
+    size_t Size() const {
+        return memo_.size();
+    }
+
+    // Forgets the words looked up so far, no report may be in progress.
+    void Clear() {
+        memo_.clear();
+    }
+
+private:
+    static constexpr size_t kMinPoolWords = 256;
+
+    void Store(const std::vector<std::string>& pending, const std::vector<Suggestion>& results) {
+        for (size_t i = 0; i < pending.size(); ++i) {
+            memo_[pending[i]] = results[i];
+        }
+    }
+
+    static std::string Key(std::string_view word) {
+        std::string key(word);
+        for (auto& c : key) {
+            c = ToLower(c);
+        }
+        return key;
+    }
+
+    const DictIndex* index_;
+    unsigned threads_;
+    std::unordered_map<std::string, Suggestion> memo_;
+};
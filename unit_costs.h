@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Bump whenever the content of a cost file changes.
+constexpr int kUnitCostsVersion = 1;
+
+// What checking a unit costs: the wall time and the memory of its AST.
+struct UnitCost {
+    double ms;
+    uint64_t memory;
+};
+
+// The costs of the units in earlier runs, by file, kept in a JSON file between the
+// runs. A unit not seen before gets an estimate from its size and the number of its
+// #include lines, which only has to order it roughly among the others until its
+// first run is recorded.
+class UnitCosts {
+public:
+    // A missing or unreadable file leaves the costs empty.
+    void Load(const std::string& path) {
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer) {
+            return;
+        }
+        auto value = llvm::json::parse((*buffer)->getBuffer());
+        if (!value) {
+            llvm::consumeError(value.takeError());
+            return;
+        }
+        auto* object = value->getAsObject();
+        auto* units = object ? object->getObject("units") : nullptr;
+        if (!units || object->getInteger("version").getValueOr(0) != kUnitCostsVersion) {
+            return;
+        }
+        for (const auto& [file, entry] : *units) {
+            auto* cost = entry.getAsObject();
+            auto ms = cost ? cost->getNumber("ms") : llvm::None;
+            auto memory = cost ? cost->getInteger("memory") : llvm::None;
+            if (ms && memory && *memory >= 0) {
+                costs_[file.str()] = {*ms, static_cast<uint64_t>(*memory)};
+            }
+        }
+    }
+
+    bool Save(const std::string& path) const {
+        std::lock_guard lock(mutex_);
+        llvm::json::Object units;
+        for (const auto& [file, cost] : costs_) {
+            units[file] = llvm::json::Object{{"ms", cost.ms}, {"memory", cost.memory}};
+        }
+        std::string text;
+        llvm::raw_string_ostream os(text);
+        os << llvm::json::Value(
+                  llvm::json::Object{{"version", kUnitCostsVersion}, {"units", std::move(units)}})
+           << '\n';
+        os.flush();
+        if (auto error = llvm::writeFileAtomically(path + ".%%%%%%%%.tmp", path, text)) {
+            llvm::errs() << path << ": " << llvm::toString(std::move(error)) << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    UnitCost Get(const std::string& file) const {
+        {
+            std::lock_guard lock(mutex_);
+            auto it = costs_.find(file);
+            if (it != costs_.end()) {
+                return it->second;
+            }
+        }
+        return Estimate(file);
+    }
+
+    void Record(const std::string& file, UnitCost cost) {
+        std::lock_guard lock(mutex_);
+        costs_[file] = cost;
+    }
+
+private:
+    // Roughly what a unit of a few kilobytes including several standard headers
+    // costs; only the relation between the estimates matters for the order.
+    static constexpr double kMsPerInclude = 40;
+    static constexpr uint64_t kMemoryPerInclude = 8 << 20;
+    static constexpr uint64_t kMemoryPerByte = 64;
+
+    static UnitCost Estimate(const std::string& file) {
+        auto buffer = llvm::MemoryBuffer::getFile(file, false, false);
+        if (!buffer) {
+            return {kMsPerInclude, kMemoryPerInclude};
+        }
+        llvm::StringRef text = (*buffer)->getBuffer();
+        uint64_t memory = kMemoryPerByte * text.size();
+        size_t includes = 0;
+        while (!text.empty()) {
+            llvm::StringRef line;
+            std::tie(line, text) = text.split('\n');
+            includes += line.ltrim().startswith("#include");
+        }
+        memory += kMemoryPerInclude * (includes + 1);
+        return {kMsPerInclude * static_cast<double>(includes + 1), memory};
+    }
+
+    mutable std::mutex mutex_;               // NOLINT
+    std::map<std::string, UnitCost> costs_;  // NOLINT
+};
+
+// The makespan of running units of the given durations in this order on a number
+// of workers, each taking the next unit as soon as it is free.
+inline double Makespan(const std::vector<double>& durations, unsigned workers) {
+    std::priority_queue<double, std::vector<double>, std::greater<double>> free_at;
+    for (unsigned i = 0; i < std::max(workers, 1u); ++i) {
+        free_at.push(0);
+    }
+    double end = 0;
+    for (double duration : durations) {
+        double start = free_at.top();
+        free_at.pop();
+        free_at.push(start + duration);
+        end = std::max(end, start + duration);
+    }
+    return end;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+// The connection of check_names -serve and its client: a Unix domain stream socket,
+// one JSON request from the client, shut down for writing after it, and one JSON
+// answer from the server, the connection is closed after it.
+
+inline llvm::Error SocketError(const std::string& what) {
+    return llvm::createStringError(std::error_code(errno, std::generic_category()), "%s: %s",
+                                   what.c_str(), std::strerror(errno));
+}
+
+inline llvm::Expected<sockaddr_un> SocketAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "%s: the socket path is too long", path.c_str());
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// A socket listening on path. A socket file left by a server that is gone is
+// replaced, the one of a running server is not.
+inline llvm::Expected<int> ListenUnix(const std::string& path) {
+    auto address = SocketAddress(path);
+    if (!address) {
+        return address.takeError();
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return SocketError("socket");
+    }
+    auto fail = [&] {
+        auto error = SocketError(path);
+        close(fd);
+        return error;
+    };
+    auto* raw = reinterpret_cast<const sockaddr*>(&*address);
+    if (bind(fd, raw, sizeof(*address)) != 0) {
+        if (errno != EADDRINUSE) {
+            return fail();
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool alive = probe >= 0 && connect(probe, raw, sizeof(*address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (alive) {
+            errno = EADDRINUSE;
+            return fail();
+        }
+        unlink(path.c_str());
+        if (bind(fd, raw, sizeof(*address)) != 0) {
+            return fail();
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        return fail();
+    }
+    return fd;
+}
+
+inline llvm::Expected<int> ConnectUnix(const std::string& path) {
+    auto address = SocketAddress(path);
+    if (!address) {
+        return address.takeError();
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return SocketError("socket");
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) != 0) {
+        auto error = SocketError(path);
+        close(fd);
+        return error;
+    }
+    return fd;
+}
+
+// Reads until the other side shuts the connection down for writing. Fails with
+// errno EMSGSIZE once more than limit bytes arrive and with ETIMEDOUT if the data
+// is not complete within timeout_ms milliseconds of the call (-1: no limit).
+inline bool ReadAll(int fd, std::string& data, size_t limit = std::string::npos,
+                    int timeout_ms = -1) {
+    using Clock = std::chrono::steady_clock;
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    char buffer[1 << 16];
+    while (true) {
+        if (timeout_ms >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                                              Clock::now());
+            pollfd entry{fd, POLLIN, 0};
+            int ready = left.count() > 0 ? poll(&entry, 1, static_cast<int>(left.count())) : 0;
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ready == 0) {
+                errno = ETIMEDOUT;
+                return false;
+            }
+            if (ready < 0) {
+                return false;
+            }
+        }
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count == 0) {
+            return true;
+        }
+        if (count < 0 && errno != EINTR) {
+            return false;
+        }
+        if (count > 0) {
+            if (data.size() + count > limit) {
+                errno = EMSGSIZE;
+                return false;
+            }
+            data.append(buffer, count);
+        }
+    }
+}
+
+// Makes a blocked send on fd fail with EAGAIN after timeout_ms milliseconds.
+inline bool SetSendTimeout(int fd, int timeout_ms) {
+    timeval timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+}
+
+inline bool WriteAll(int fd, llvm::StringRef data) {
+    while (!data.empty()) {
+        ssize_t count = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (count < 0 && errno != EINTR) {
+            return false;
+        }
+        if (count > 0) {
+            data = data.drop_front(count);
+        }
+    }
+    return true;
+}